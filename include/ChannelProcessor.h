@@ -3,33 +3,70 @@
 #include <cassert>
 #include <vector>
 #include <cmath>
+#include <span>
+#include <array>
+#include <memory_resource>
 
+#include "LiblufsAPI.h"
 #include "Channel.h"
 #include "Filter.h"
+#include "KWeightingKernel.h"
 
 namespace LUFS
 {
 
-class ChannelProcessor
+class LIBLUFS_API ChannelProcessor
 {
 public:
-    ChannelProcessor(float channelWeighting, size_t blockSizeSamples);
+    //The stored block is allocated from the memory resource
+    ChannelProcessor(float channelWeighting, size_t blockSizeSamples, double sampleRate, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
     
     float getWeighting() const;
 
     float filterSample(float sample);
 
+    //Filters a block of samples with both stages in one loop and returns the sum of squares of the filtered samples
+    //Filtered samples stay in double precision, so this is slightly more accurate than squaring the results of filterSample
+    double filterBlock(std::span<const float> samples);
+
+    //Filters interleaved audio with a processor per channel, the channels are filtered together in SIMD lanes where the CPU supports it
+    //Returns the channel weighted sum of squares of the filtered samples, each channel gives the same result as filterBlock
+    static double filterInterleaved(std::span<ChannelProcessor> processors, std::span<const float> audio);
+
+    //The K weighting filters at a sample rate, for filtering state held outside of a processor with KWeightingKernel
+    static KWeightingKernel::Coefficients calculateKernelCoefficients(double sampleRate);
+
     void reset();
 
     float getCurrentBlockMeanSquares() const;
 
-    std::vector<float> currentBlockData;
+    //Writes a filtered sample into the block and keeps a running sum of squares, blocks must be written sequentially
+    void storeSample(size_t blockIndex, float filteredSample);
+
+    //Constant time equivalent of getCurrentBlockMeanSquares for blocks written with storeSample
+    float getRunningBlockMeanSquares() const;
+
+    std::pmr::vector<float> currentBlockData;
 
 private:
-    void initialiseFilters();
+    //Calculates the K weighting filters for the sample rate as described in ITU-R BS.1770
+    void initialiseFilters(double sampleRate);
+
+    KWeightingKernel::Coefficients getKernelCoefficients() const;
+    KWeightingKernel::LaneState getKernelState() const;
+    void setKernelState(const KWeightingKernel::LaneState& state);
+
+    //Channels are filtered in groups of this many lanes so their state can be gathered on the stack
+    static constexpr size_t maxKernelLanes = 8;
 
     float weighting;
 
+    //Sum of squares of the whole block, updated as samples enter and leave
+    double runningSumSquares = 0.0;
+
+    //Sum of squares of the samples written since the last wrap, replaces the running sum each wrap so rounding errors can't accumulate
+    double freshSumSquares = 0.0;
+
     Filter filt1;
     Filter filt2;
 };
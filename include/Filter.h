@@ -35,6 +35,23 @@ public:
         prev = 0.0;
         last = 0.0;
     }
+
+    //Lets the state be moved in and out of kernels that run several filters at once
+    double getPrev() const
+    {
+        return prev;
+    }
+
+    double getLast() const
+    {
+        return last;
+    }
+
+    void setState(double newPrev, double newLast)
+    {
+        prev = newPrev;
+        last = newLast;
+    }
     
 private:
     double prev = 0.0f;
@@ -3,11 +3,13 @@
 #include <chrono>
 #include <cmath>
 #include <span>
-#include <mutex>
+#include <memory_resource>
+#include <stdexcept>
 
 #include "LiblufsAPI.h"
-#include "DoubleBuffer.h"
+#include "SnapshotPublisher.h"
 #include "ChannelProcessor.h"
+#include "SubBlockRing.h"
 
 namespace LUFS
 {
@@ -15,8 +17,21 @@ namespace LUFS
 class LIBLUFS_API FixedTermLoudnessMeter
 {
 public:
+    enum class Resolution
+    {
+        //The window moves every sample, every filtered sample in the window is stored
+        Sample,
+
+        //The window moves in 100ms steps, only a sum of squares is stored for each 100ms so the window length must be a multiple of 100ms
+        SubBlock
+    };
+
     //Min level will be used if there is silence or not enough data has been processed
-    FixedTermLoudnessMeter(const std::vector<Channel>& channelSet, const std::chrono::milliseconds& windowLength, float minLevel = -100.0f);
+    //Everything the meter needs is allocated from the memory resource when it is constructed, resetting doesn't allocate
+    FixedTermLoudnessMeter(double sampleRate, const std::vector<Channel>& channelSet, const std::chrono::milliseconds& windowLength, float minLevel = -100.0f, Resolution windowResolution = Resolution::Sample, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Measures at 48kHz
+    FixedTermLoudnessMeter(const std::vector<Channel>& channelSet, const std::chrono::milliseconds& windowLength, float minLevel = -100.0f, Resolution windowResolution = Resolution::Sample, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
     ~FixedTermLoudnessMeter();
     
     //Deinterleaved and interleaved
@@ -29,24 +44,50 @@ public:
     //This can only be called from the same thread as the process calls
     float getLoudnessRealtime();
 
-    //This is threadsafe with process calls
+    //This is threadsafe with process calls and itself
     float getLoudness() const;
 
 private:
+    //The only state readers need, published after every process call so the channel processors never have to be copied
+    struct Summary
+    {
+        double weightedMeanSquares = 0.0;
+    };
+
     int getBlockLengthSamples(const std::chrono::milliseconds& windowLength) const;
+    size_t getNumSubBlocks() const;
 
-    std::vector<ChannelProcessor> generateChannelProcessors() const;
+    //For the per sample window
+    void addSample(size_t channelIndex, float sample);
+    void advanceWritePos();
 
-    const std::vector<Channel> channels;
-    const int blockLengthSamples;
+    //Pushes the current sub block once it is full
+    void advanceSubBlockWritePos(size_t numSamples);
+
+    std::pmr::vector<ChannelProcessor> generateChannelProcessors(const std::vector<Channel>& channelSet, std::pmr::memory_resource* memoryResource) const;
+
+    double calculateWeightedMeanSquares() const;
+    void publishSummary();
+
+    float convertToLoudness(double weightedMeanSquares) const;
+
+    const double sampleRate;
+    const size_t subBlockLengthSamples;
     const float min;
+    const Resolution resolution;
+    const int blockLengthSamples;
+
+    std::pmr::vector<ChannelProcessor> channelProcessors;
+
+    //Only used with sub block resolution
+    SubBlockRing subBlocks;
+    double currentSubBlockSum = 0.0;
 
-    mutable std::mutex channelProcessorsOfflineLock;
-    DoubleBuffer<std::vector<ChannelProcessor>> channelProcessors;
+    SnapshotPublisher<Summary> summary;
 
     size_t blockWritePos = 0;
 
-    static constexpr int sampleRate = 48000;
+    static constexpr double defaultSampleRate = 48000.0;
 };
 
 }
@@ -5,13 +5,12 @@
 #include <cmath>
 #include <span>
 #include <iterator>
-#include <mutex>
+#include <memory_resource>
 
 #include "LiblufsAPI.h"
 #include "ChannelProcessor.h"
-#include "Block.h"
-#include "HistogramBlock.h"
-#include "DoubleBuffer.h"
+#include "SubBlockRing.h"
+#include "LoudnessHistogram.h"
 
 namespace LUFS
 {
@@ -20,7 +19,11 @@ class LIBLUFS_API IntegratedLoudnessMeter
 {
 public:
     //Min level will be used if there is silence or not enough data has been processed
-    IntegratedLoudnessMeter(const std::vector<Channel>& channels, float minLevel = -100.0f);
+    //Everything the meter needs is allocated from the memory resource when it is constructed, so an arena can hold the whole meter
+    IntegratedLoudnessMeter(double sampleRate, const std::vector<Channel>& channels, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Measures at 48kHz
+    IntegratedLoudnessMeter(const std::vector<Channel>& channels, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
     ~IntegratedLoudnessMeter();
     
     //Deinterleaved and interleaved
@@ -30,47 +33,54 @@ public:
     //This is not threadsafe with process calls
     void reset();
 
+    //Starts measuring again from the current position but keeps the filter state and partly processed gating blocks, so audio
+    //processed before this only primes the meter, this is not threadsafe with process calls
+    void resetIntegration();
+
     //This is for getting the loudness on the same thread as process calls, it is not threadsafe with process calls
     float getLoudnessRealtime();
 
     //This is threadsafe with process calls and itself
     float getLoudness() const;
 
-private:
-    void processCurrentBlock();
-    void calculateBlockLoudness(Block& block) const;
-
-    size_t getHistogramBinIndexForLoudness(float loudness) const;
+    //Copies out the gated blocks measured so far so they can be merged with those of other meters, this is threadsafe with process calls but allocates
+    LoudnessHistogramState getState() const;
 
-    std::vector<HistogramBlock> generateBlankHistogram(size_t numChannels) const;
+    //Integrated loudness of a state, which can be made by merging the states of several meters
+    static float calculateLoudness(const LoudnessHistogramState& state, float minLevel = -100.0f);
 
-    double calculateLoudnessWithThreshold(const std::vector<HistogramBlock>& histogram, const std::optional<float>& threshold) const;
+private:
+    void processCurrentSubBlock();
 
     const float min;
+
+    //Sub blocks are the length of the step between gating blocks
+    const size_t subBlockLengthSamples;
+    const size_t blockLengthSamples;
     
-    std::vector<ChannelProcessor> channelProcessors;
+    std::pmr::vector<ChannelProcessor> channelProcessors;
 
-    Block processBlock;
+    //Each gating block is made of the channel weighted sums of squares of its last few sub blocks, so no samples need storing
+    SubBlockRing subBlocks;
+    double currentSubBlockSum = 0.0;
 
-    mutable std::mutex histogramOfflineLock;
-    DoubleBuffer<std::vector<HistogramBlock>> blockHistogram;
-    float histogramMappingSlope = 0.0f;
+    //Blocks are added in place so readers never need a copy of the histogram
+    LoudnessHistogram blockHistogram;
 
-    size_t currentBlockWritePos = 0;
+    size_t currentSubBlockWritePos = 0;
 
-    static constexpr int sampleRate = 48000;
+    static constexpr double defaultSampleRate = 48000.0;
     static constexpr int blockLengthMs = 400;
-    static constexpr int blockLengthSamples = (blockLengthMs / 1000.0) * sampleRate;
     static constexpr float overlap = 0.75f;
     static constexpr int overlapLengthMs = blockLengthMs * (1.0f - overlap);
-    static constexpr int overlapLengthSamples = (overlapLengthMs / 1000.0) * sampleRate;
 
-    static constexpr float gateAbsoluteThreshold = -70.0f;
+    static_assert(overlapLengthMs == SubBlockRing::subBlockLengthMs);
+    static constexpr size_t numSubBlocksPerBlock = blockLengthMs / overlapLengthMs;
+    static_assert(blockLengthMs % overlapLengthMs == 0);
 
-    static constexpr float highestIntegratedValue = 0.0f;
-    static constexpr float lowestIntegratedValue = gateAbsoluteThreshold;
-    static constexpr float integratedHistogramResolution = 0.01f;
-    static constexpr size_t numHistogramElements = (1.0f / integratedHistogramResolution) * (highestIntegratedValue - lowestIntegratedValue);
+    //The absolute gate of -70 LUFS is applied by the range of the histogram
+    static_assert(LoudnessHistogram::lowestValue == -70.0f);
+    static constexpr float gateRelativeThreshold = -10.0f;
 };
 
 }
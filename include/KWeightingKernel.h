@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cassert>
+
+#include "LiblufsAPI.h"
+
+namespace LUFS
+{
+
+//Runs the K weighting filters of several channels together, each channel being a lane of the widest registers the CPU supports
+//The recursion of each filter can't be vectorised over time, but independent channels can share an instruction
+class LIBLUFS_API KWeightingKernel
+{
+public:
+    struct Stage
+    {
+        double a1 = 0.0, a2 = 0.0, b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    };
+
+    struct Coefficients
+    {
+        Stage shelf;
+        Stage highPass;
+    };
+
+    //The state of both stages of one lane
+    struct LaneState
+    {
+        double shelfPrev = 0.0, shelfLast = 0.0;
+        double highPassPrev = 0.0, highPassLast = 0.0;
+    };
+
+    enum class InstructionSet
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    //Filters numFrames frames of numLanes lanes, lane l of frame f is read from input[f * stride + l]
+    //Adds each lanes sum of squares of filtered samples to sumsOfSquares at full precision, and writes the filtered samples to output with the same layout if it isn't null
+    static void process(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output);
+
+    //As above with a particular instruction set, which must be no wider than the one chosen for this CPU
+    //Every instruction set gives identical results, this lets them be compared
+    static void process(InstructionSet instructionSet, const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output);
+
+    //The instruction set chosen for this CPU the first time it is asked for
+    static InstructionSet getInstructionSet();
+
+private:
+    static void processScalar(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output);
+    static void processSSE2(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output);
+
+    //Defined in its own translation unit so only it is built for AVX2, returns how many lanes it processed
+    static size_t processAVX2(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output);
+
+    static InstructionSet detectInstructionSet();
+};
+
+}
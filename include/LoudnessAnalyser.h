@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cmath>
+#include <span>
+#include <memory_resource>
+
+#include "LiblufsAPI.h"
+#include "SubBlockFilter.h"
+#include "SubBlockRing.h"
+#include "LoudnessHistogram.h"
+#include "SnapshotPublisher.h"
+
+namespace LUFS
+{
+
+//Measures momentary, short term and integrated loudness and loudness range from a single K-weighting pass
+//Momentary and short term loudness are updated every 100ms
+class LIBLUFS_API LoudnessAnalyser
+{
+public:
+    //Min level will be used if there is silence or not enough data has been processed
+    //Everything the analyser needs is allocated from the memory resource when it is constructed
+    LoudnessAnalyser(double sampleRate, const std::vector<Channel>& channels, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Measures at 48kHz
+    LoudnessAnalyser(const std::vector<Channel>& channels, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+    ~LoudnessAnalyser();
+
+    //Deinterleaved and interleaved
+    void process(std::span<const float* const> audio, int numSamplesPerChannel);
+    void process(std::span<const float> audio);
+
+    //This is not threadsafe with process calls
+    void reset();
+
+    //These are threadsafe with process calls and each other
+    float getMomentaryLoudness() const;
+    float getShortTermLoudness() const;
+    float getIntegratedLoudness() const;
+
+    //In LU, will be 0 if there is not enough data
+    float getLoudnessRange() const;
+
+private:
+    struct Summary
+    {
+        double momentaryMeanSquares = 0.0;
+        double shortTermMeanSquares = 0.0;
+    };
+
+    void processSubBlock(double subBlockSum);
+
+    float convertToLoudness(double meanSquares) const;
+
+    const float min;
+
+    SubBlockFilter subBlockFilter;
+
+    //Holds the channel weighted sum of squares of each sub block
+    SubBlockRing subBlocks;
+
+    SnapshotPublisher<Summary> summary;
+
+    //Every 400ms gating block
+    LoudnessHistogram integratedHistogram;
+
+    //Every short term value
+    LoudnessHistogram shortTermHistogram;
+
+    static constexpr double defaultSampleRate = 48000.0;
+    static constexpr size_t numMomentarySubBlocks = 4;
+    static constexpr size_t numShortTermSubBlocks = 30;
+
+    static constexpr float integratedGateRelativeThreshold = -10.0f;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <utility>
+#include <memory_resource>
+#include <algorithm>
+#include <optional>
+#include <cmath>
+#include <atomic>
+#include <cassert>
+
+#include "SequenceLock.h"
+#include "LoudnessHistogramState.h"
+
+namespace LUFS
+{
+
+//Accumulates blocks by their loudness so gated and percentile loudness can be calculated without storing every block
+//Each bin only holds the summed channel weighted mean squares of its blocks and how many blocks there were, as that is all gating needs
+//Bins are stored as a Fenwick tree so adding a block and every query is O(log bins)
+//One thread can add blocks while any number of threads run calculations, adding a block never blocks and only touches the nodes it changes
+class LoudnessHistogram
+{
+public:
+    struct Node
+    {
+        std::atomic<double> meanSquares = 0.0;
+        std::atomic<double> numBlocks = 0.0;
+    };
+
+    //The bins are allocated from the memory resource
+    LoudnessHistogram(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Views nodes held elsewhere, such as a slice of one array shared by many histograms, they must hold numNodes and outlive the histogram
+    explicit LoudnessHistogram(std::span<Node> externalNodes);
+
+    //Only for filling containers before the histogram is used, moving it while other threads use it is a data race
+    LoudnessHistogram(LoudnessHistogram&& other) noexcept;
+
+    //Returns false if the block was ignored because its loudness is outside of the range of the histogram
+    bool addBlock(double weightedMeanSquares);
+
+    //Must be called from the same thread as addBlock
+    void clear();
+
+    //Copies out the blocks added so far, this allocates so should not be called from a realtime thread
+    LoudnessHistogramState getState() const;
+
+    //Mean loudness of all blocks at or above the threshold, returns nothing if there are no blocks
+    std::optional<double> calculateMeanLoudness(const std::optional<float>& threshold) const;
+
+    //Loudness that the given proportion (0-1) of blocks at or above the threshold fall below, returns nothing if there are no blocks
+    std::optional<float> calculatePercentileLoudness(float percentile, const std::optional<float>& threshold) const;
+
+    //Mean loudness of all blocks at or above the relative gate, which is relative to the mean loudness of all blocks
+    std::optional<double> calculateGatedLoudness(float relativeGate) const;
+
+    //Difference between the low and high percentile loudness of all blocks at or above the relative gate
+    std::optional<float> calculateGatedLoudnessRange(float relativeGate, float lowPercentile, float highPercentile) const;
+
+    static double convertToLoudness(double weightedMeanSquares);
+    static size_t getBinIndexForLoudness(float loudness);
+
+    static constexpr float highestValue = 0.0f;
+    static constexpr float lowestValue = -70.0f;
+    static constexpr float resolution = 0.01f;
+    static constexpr size_t numBins = (1.0f / resolution) * (highestValue - lowestValue);
+
+    //Fenwick tree indexed from 1, node 0 is unused
+    static constexpr size_t numNodes = numBins + 1;
+
+private:
+    struct Bin
+    {
+        double meanSquares = 0.0;
+
+        //Stored as a double which is exact up to 2^53 blocks
+        double numBlocks = 0.0;
+    };
+
+    //These do not synchronise with addBlock so must be called through the sequence lock
+    std::optional<double> calculateMeanLoudnessUnsynchronised(const std::optional<float>& threshold) const;
+    std::optional<float> calculatePercentileLoudnessUnsynchronised(float percentile, const std::optional<float>& threshold) const;
+
+    //Sums the bins below the given index
+    Bin sumBinsBelow(size_t binIndex) const;
+
+    float getLoudnessForBinIndex(size_t binIndex) const;
+
+    //Empty when the nodes are held elsewhere
+    std::pmr::vector<Node> ownedNodes;
+    std::span<Node> nodes;
+
+    SequenceLock nodesLock;
+
+    static constexpr float mappingSlope = (numBins - 1.0f) / (highestValue - lowestValue);
+};
+
+}
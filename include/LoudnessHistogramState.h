@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+
+#include "LiblufsAPI.h"
+
+namespace LUFS
+{
+
+//A copy of the blocks held by a loudness histogram that can be stored, sent elsewhere and merged with other copies
+//Merging the states of meters that measured different parts of a programme gives the same result as measuring the whole programme with one meter,
+//apart from the blocks that would have crossed the joins between the parts
+class LIBLUFS_API LoudnessHistogramState
+{
+public:
+    LoudnessHistogramState();
+
+    //Adds the blocks of the other state as if they had been added to this one
+    void merge(const LoudnessHistogramState& other);
+
+    //Mean loudness of all blocks at or above the relative gate, which is relative to the mean loudness of all blocks
+    std::optional<double> calculateGatedLoudness(float relativeGate) const;
+
+    uint64_t getNumBlocks() const;
+
+private:
+    friend class LoudnessHistogram;
+
+    struct Bin
+    {
+        size_t index = 0;
+        double meanSquares = 0.0;
+        double numBlocks = 0.0;
+    };
+
+    //Only bins that hold blocks, ordered by index
+    std::vector<Bin> bins;
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <span>
+#include <memory_resource>
+
+#include "LiblufsAPI.h"
+#include "SubBlockFilter.h"
+#include "SubBlockRing.h"
+#include "LoudnessHistogram.h"
+
+namespace LUFS
+{
+
+//Measures loudness range according to EBU Tech 3342, memory use does not grow with the length of the programme
+//This measures it the same way as LoudnessAnalyser but only keeps the short term values, for when only loudness range is needed
+class LIBLUFS_API LoudnessRangeMeter
+{
+public:
+    //Everything the meter needs is allocated from the memory resource when it is constructed
+    LoudnessRangeMeter(double sampleRate, const std::vector<Channel>& channels, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Measures at 48kHz
+    LoudnessRangeMeter(const std::vector<Channel>& channels, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+    ~LoudnessRangeMeter();
+
+    //Deinterleaved and interleaved
+    void process(std::span<const float* const> audio, int numSamplesPerChannel);
+    void process(std::span<const float> audio);
+
+    //This is not threadsafe with process calls
+    void reset();
+
+    //In LU, will be 0 if there is not enough data
+    //This is threadsafe with process calls and itself
+    float getLoudnessRange() const;
+
+    //Loudness range of a histogram of every short term value, shared with LoudnessAnalyser
+    static float calculateLoudnessRange(const LoudnessHistogram& shortTermHistogram);
+
+private:
+    void processSubBlock(double subBlockSum);
+
+    SubBlockFilter subBlockFilter;
+
+    //Short term blocks are made of the channel weighted sums of squares of their sub blocks
+    SubBlockRing subBlocks;
+
+    //Every short term value
+    LoudnessHistogram shortTermHistogram;
+
+    static constexpr double defaultSampleRate = 48000.0;
+    static constexpr int shortTermLengthMs = 3000;
+    static constexpr size_t numSubBlocksPerShortTermBlock = shortTermLengthMs / SubBlockRing::subBlockLengthMs;
+
+    //The -70 LUFS absolute gate is applied by the range of the histogram
+    static_assert(LoudnessHistogram::lowestValue == -70.0f);
+    static constexpr float gateRelativeThreshold = -20.0f;
+    static constexpr float lowPercentile = 0.10f;
+    static constexpr float highPercentile = 0.95f;
+};
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <array>
+#include <atomic>
+#include <memory_resource>
+
+#include "LiblufsAPI.h"
+#include "Channel.h"
+#include "KWeightingKernel.h"
+#include "SubBlockRing.h"
+#include "SequenceLock.h"
+#include "LoudnessHistogram.h"
+#include "ThreadPool.h"
+
+namespace LUFS
+{
+
+//Measures many streams with the same channel layout, such as a set of broadcast feeds, from one object
+//The state of every stream is held in a few contiguous arrays and a batch of every stream's audio is measured in parallel
+class LIBLUFS_API MeterBank
+{
+public:
+    enum class Measurements
+    {
+        //Each stream only needs a few cache lines, about 320 bytes of state plus its filter states
+        MomentaryAndShortTerm,
+
+        //Also measures integrated loudness, which adds a histogram of about 112kB to every stream
+        //That is the 7000 bins of a 0.01LU Fenwick tree at 16 bytes each, so a bank of 1000 streams needs about 112MB
+        MomentaryShortTermAndIntegrated
+    };
+
+    struct Readout
+    {
+        float momentaryLoudness = 0.0f;
+        float shortTermLoudness = 0.0f;
+
+        //Min level when integrated loudness isn't measured
+        float integratedLoudness = 0.0f;
+    };
+
+    //Min level will be used if there is silence or not enough data has been processed, if numThreads is 0 the number of hardware threads will be used
+    //The state of every stream is allocated from the memory resource when the bank is constructed, only the thread pool's threads aren't
+    MeterBank(double sampleRate, const std::vector<Channel>& channels, size_t numStreams, Measurements measurements = Measurements::MomentaryAndShortTerm, size_t numThreads = 0, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Measures at 48kHz
+    MeterBank(const std::vector<Channel>& channels, size_t numStreams, Measurements measurements = Measurements::MomentaryAndShortTerm, size_t numThreads = 0, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+    ~MeterBank();
+
+    //One entry per stream, deinterleaved and interleaved
+    //Streams are independent so interleaved buffers don't need to be the same length
+    //These must not be called concurrently
+    void process(std::span<const std::span<const float* const>> streamAudio, int numSamplesPerChannel);
+    void process(std::span<const std::span<const float>> streamAudio);
+
+    //For streams that share block boundaries, such as feeds from one capture card, every frame holds each stream's channels in stream order
+    //Stream s channel c of frame f is at audio[(f * numStreams + s) * numChannels + c]
+    //Every stream is filtered side by side in SIMD lanes and sub block boundaries are checked once for all of them
+    //That needs every stream at the same point in its sub blocks, so they should only be processed with this or with buffers of equal lengths
+    //Streams that aren't are still measured correctly but are processed one at a time, which is slower
+    void processLockstep(std::span<const float> audio);
+
+    //These are not threadsafe with process calls
+    void reset();
+    void resetStream(size_t streamIndex);
+
+    //Fills one readout per stream, this is threadsafe with process calls and itself
+    void getReadouts(std::span<Readout> readouts) const;
+
+    size_t getNumStreams() const;
+
+private:
+    static constexpr size_t numMomentarySubBlocks = 4;
+    static constexpr size_t numShortTermSubBlocks = 30;
+
+    //Everything about a stream except its filter state, which depends on the number of channels, and its integrated histogram
+    //Aligned to cache lines so threads measuring neighbouring streams don't share any, this is 5 of them
+    struct alignas(64) StreamState
+    {
+        double currentSubBlockSum = 0.0;
+        size_t subBlockWritePos = 0;
+
+        //The channel weighted sums of squares of the latest sub blocks, oldest first from the write position
+        std::array<double, numShortTermSubBlocks> subBlockSums{};
+        size_t subBlockSumsWritePos = 0;
+        size_t numSubBlocks = 0;
+
+        double momentaryMeanSquares = 0.0;
+        double shortTermMeanSquares = 0.0;
+    };
+
+    //What readers see of each stream, written through the readouts lock
+    struct PublishedState
+    {
+        std::atomic<double> momentaryMeanSquares = 0.0;
+        std::atomic<double> shortTermMeanSquares = 0.0;
+    };
+
+    //Returns the channel weighted sum of squares of the filtered frames, lane l of frame f is read from input[f * stride + l]
+    double filterLanes(KWeightingKernel::LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, const float* laneWeightings) const;
+
+    void processStream(size_t streamIndex, std::span<const float* const> audio, size_t numSamplesPerChannel);
+
+    //Channel c of frame f is read from audio[f * stride + c]
+    void processStream(size_t streamIndex, const float* audio, size_t stride, size_t numFrames);
+
+    //Processes streams from firstStream up to endStream of a lockstep buffer
+    void processLockstepStreams(size_t firstStream, size_t endStream, std::span<const float> audio);
+
+    //Pushes the current sub block of a stream once it is full
+    void advanceSubBlockWritePos(size_t streamIndex, size_t numSamples);
+    void completeSubBlock(size_t streamIndex);
+
+    void publishReadouts();
+
+    float convertToLoudness(double meanSquares) const;
+
+    const size_t numChannels;
+    const size_t numStreams;
+    const size_t subBlockLengthSamples;
+    const float min;
+
+    const KWeightingKernel::Coefficients coefficients;
+    std::pmr::vector<float> channelWeightings;
+
+    std::pmr::vector<StreamState> streams;
+
+    //Stream s channel c is at s * numChannels + c
+    std::pmr::vector<KWeightingKernel::LaneState> filterStates;
+
+    //Each lane's sum of squares of a lockstep sub block, laid out like the filter states
+    std::pmr::vector<double> laneSumsOfSquares;
+
+    //Empty unless integrated loudness is measured, every stream's histogram nodes in one array with stream s from s * LoudnessHistogram::numNodes
+    //These are far larger than everything else in the bank, see Measurements
+    std::pmr::vector<LoudnessHistogram::Node> integratedHistogramNodes;
+
+    //Every 400ms gating block of each stream, each one views its stream's slice of the nodes
+    std::pmr::vector<LoudnessHistogram> integratedHistograms;
+
+    std::pmr::vector<PublishedState> publishedStates;
+    SequenceLock readoutsLock;
+
+    ThreadPool threadPool;
+
+    static constexpr double defaultSampleRate = 48000.0;
+
+    //Channels are filtered in groups of this many lanes so their sums of squares can be gathered on the stack
+    static constexpr size_t maxKernelLanes = 8;
+
+    //Lockstep streams are only split between threads when each thread gets at least this many lanes
+    static constexpr size_t minLockstepLanesPerThread = 64;
+
+    static constexpr float integratedGateRelativeThreshold = -10.0f;
+};
+
+}
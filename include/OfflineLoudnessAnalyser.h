@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <span>
+
+#include "LiblufsAPI.h"
+#include "Channel.h"
+#include "ThreadPool.h"
+#include "SubBlockRing.h"
+#include "LoudnessHistogramState.h"
+
+namespace LUFS
+{
+
+//Measures integrated loudness of a whole programme held in memory by splitting it into chunks that are measured in parallel
+//Each chunk after the first is primed with the audio before it, so the result matches a single IntegratedLoudnessMeter
+class LIBLUFS_API OfflineLoudnessAnalyser
+{
+public:
+    //If numThreads is 0 the number of hardware threads will be used
+    OfflineLoudnessAnalyser(double sampleRate, const std::vector<Channel>& channels, size_t numThreads = 0);
+
+    //Measures at 48kHz
+    OfflineLoudnessAnalyser(const std::vector<Channel>& channels, size_t numThreads = 0);
+    ~OfflineLoudnessAnalyser();
+
+    //Deinterleaved and interleaved, the returned state can be passed to IntegratedLoudnessMeter::calculateLoudness or merged with others
+    //These must not be called concurrently
+    LoudnessHistogramState analyse(std::span<const float* const> audio, size_t numSamplesPerChannel);
+    LoudnessHistogramState analyse(std::span<const float> audio);
+
+    //Integrated loudness, min level will be used if there is silence or not enough data
+    float analyseLoudness(std::span<const float* const> audio, size_t numSamplesPerChannel, float minLevel = -100.0f);
+    float analyseLoudness(std::span<const float> audio, float minLevel = -100.0f);
+
+private:
+    struct Chunk
+    {
+        //Where priming starts, the chunk itself and where it ends, in samples per channel
+        size_t warmUpStart = 0;
+        size_t start = 0;
+        size_t end = 0;
+    };
+
+    std::vector<Chunk> calculateChunks(size_t numSamplesPerChannel) const;
+
+    template<typename ProcessRange>
+    LoudnessHistogramState analyseChunks(size_t numSamplesPerChannel, ProcessRange&& processRange);
+
+    const double sampleRate;
+    const std::vector<Channel> channels;
+
+    //Chunks start on gating block steps so every chunk sees the same blocks as a single meter would
+    const size_t subBlockLengthSamples;
+
+    ThreadPool threadPool;
+
+    static constexpr double defaultSampleRate = 48000.0;
+
+    //Long enough to fill a gating block and for the K weighting filters to settle to within rounding of their state in a single pass
+    static constexpr size_t numWarmUpSubBlocks = 10;
+
+    //Keeps the cost of priming small compared to the chunk, while giving each thread a few chunks to balance the load
+    static constexpr size_t minChunkLengthSubBlocks = 300;
+    static constexpr size_t numChunksPerThread = 4;
+
+    //The meters take an int length so long chunks are processed in pieces
+    static constexpr size_t maxProcessLengthSubBlocks = 100;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace LUFS
+{
+
+//Lets one writer update shared data without ever blocking while readers detect that a write happened during their read and retry
+//Shared data must still be accessed through atomics, relaxed ordering is enough as this handles the ordering
+class SequenceLock
+{
+public:
+    SequenceLock() {}
+
+    //Only one thread may write at a time
+    void beginWrite()
+    {
+        const uint64_t current = sequence.load(std::memory_order_relaxed);
+        sequence.store(current + 1, std::memory_order_relaxed);
+
+        //Stops data writes moving before the sequence becomes odd
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void endWrite()
+    {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    //Calls the reader until it completes without a write happening at the same time, the reader must not have side effects
+    template<typename Reader>
+    auto read(Reader&& reader) const
+    {
+        while(true)
+        {
+            const uint64_t startSequence = sequence.load(std::memory_order_acquire);
+
+            //A write is in progress
+            if(startSequence & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            auto result = reader();
+
+            //Stops data reads moving after the sequence is checked
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(sequence.load(std::memory_order_relaxed) == startSequence)
+            {
+                return result;
+            }
+        }
+    }
+
+private:
+    std::atomic<uint64_t> sequence = 0;
+};
+
+}
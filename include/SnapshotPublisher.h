@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "SequenceLock.h"
+
+namespace LUFS
+{
+
+//Publishes a small trivially copyable value from one thread to any number of reader threads without locking or allocating
+//Publishing never waits for readers, a reader that overlaps a publish just reads again
+template<typename T>
+class SnapshotPublisher
+{
+public:
+    SnapshotPublisher(const T& initialValue)
+    {
+        //Checked here as nested types aren't complete until their enclosing class is
+        static_assert(std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>);
+
+        store(initialValue);
+    }
+
+    //Only one thread may publish at a time
+    void publish(const T& value)
+    {
+        lock.beginWrite();
+        store(value);
+        lock.endWrite();
+    }
+
+    //This is threadsafe with publish calls and itself
+    T read() const
+    {
+        return lock.read([this]()
+        {
+            return load();
+        });
+    }
+
+private:
+    //The value is held in atomic words so a read that overlaps a publish is not a data race, it is just discarded
+    static constexpr size_t numWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void store(const T& value)
+    {
+        std::array<uint64_t, numWords> valueWords{};
+        std::memcpy(valueWords.data(), &value, sizeof(T));
+
+        for(size_t wordIndex = 0; wordIndex < numWords; ++wordIndex)
+        {
+            words[wordIndex].store(valueWords[wordIndex], std::memory_order_relaxed);
+        }
+    }
+
+    T load() const
+    {
+        std::array<uint64_t, numWords> valueWords;
+
+        for(size_t wordIndex = 0; wordIndex < numWords; ++wordIndex)
+        {
+            valueWords[wordIndex] = words[wordIndex].load(std::memory_order_relaxed);
+        }
+
+        T value;
+        std::memcpy(static_cast<void*>(&value), valueWords.data(), sizeof(T));
+
+        return value;
+    }
+
+    SequenceLock lock;
+    std::array<std::atomic<uint64_t>, numWords> words;
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <iterator>
+#include <algorithm>
+#include <cassert>
+#include <memory_resource>
+
+#include "ChannelProcessor.h"
+#include "SubBlockRing.h"
+
+namespace LUFS
+{
+
+//K weights every channel and sums their channel weighted squares into 100ms sub blocks, for meters that only need whole sub blocks
+//Only sums of squares are kept so no samples are stored
+class SubBlockFilter
+{
+public:
+    //The channel processors are allocated from the memory resource
+    SubBlockFilter(double sampleRate, const std::vector<Channel>& channels, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource())  : subBlockLengthSamples{SubBlockRing::getSubBlockLengthSamples(sampleRate)}, channelProcessors{memoryResource}
+    {
+        channelProcessors.reserve(channels.size());
+
+        std::transform(channels.begin(), channels.end(), std::back_insert_iterator(channelProcessors), [sampleRate, memoryResource](const Channel& channel)
+        {
+            return ChannelProcessor(channel.getWeighting(), 0, sampleRate, memoryResource);
+        });
+    }
+
+    //Deinterleaved and interleaved, onSubBlockComplete is called with the channel weighted sum of squares of each sub block as it completes
+    template<typename OnSubBlockComplete>
+    void process(std::span<const float* const> audio, size_t numSamplesPerChannel, OnSubBlockComplete&& onSubBlockComplete)
+    {
+        assert(audio.size() == channelProcessors.size());
+
+        size_t bufferReadPos = 0;
+
+        while(bufferReadPos < numSamplesPerChannel)
+        {
+            const size_t numSamplesToAdd = std::min(subBlockLengthSamples - subBlockWritePos, numSamplesPerChannel - bufferReadPos);
+
+            for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
+            {
+                ChannelProcessor& channelProcessor = channelProcessors[channelIndex];
+
+                //Filter the channels samples and add its weighted sum of squares
+                currentSubBlockSum += channelProcessor.getWeighting() * channelProcessor.filterBlock({audio[channelIndex] + bufferReadPos, numSamplesToAdd});
+            }
+
+            bufferReadPos += numSamplesToAdd;
+            advanceSubBlockWritePos(numSamplesToAdd, onSubBlockComplete);
+        }
+    }
+
+    template<typename OnSubBlockComplete>
+    void process(std::span<const float> audio, OnSubBlockComplete&& onSubBlockComplete)
+    {
+        assert(audio.size() % channelProcessors.size() == 0);
+
+        const size_t numChannels = channelProcessors.size();
+        const size_t numSamplesPerChannel = audio.size() / numChannels;
+
+        size_t bufferReadPos = 0;
+
+        while(bufferReadPos < numSamplesPerChannel)
+        {
+            const size_t numSamplesToAdd = std::min(subBlockLengthSamples - subBlockWritePos, numSamplesPerChannel - bufferReadPos);
+
+            //Filter every channel together and add their weighted sums of squares
+            currentSubBlockSum += ChannelProcessor::filterInterleaved(channelProcessors, audio.subspan(bufferReadPos * numChannels, numSamplesToAdd * numChannels));
+
+            bufferReadPos += numSamplesToAdd;
+            advanceSubBlockWritePos(numSamplesToAdd, onSubBlockComplete);
+        }
+    }
+
+    void reset()
+    {
+        std::for_each(channelProcessors.begin(), channelProcessors.end(), [](ChannelProcessor& processor)
+        {
+            processor.reset();
+        });
+
+        currentSubBlockSum = 0.0;
+        subBlockWritePos = 0;
+    }
+
+    size_t getSubBlockLengthSamples() const
+    {
+        return subBlockLengthSamples;
+    }
+
+private:
+    template<typename OnSubBlockComplete>
+    void advanceSubBlockWritePos(size_t numSamples, OnSubBlockComplete& onSubBlockComplete)
+    {
+        subBlockWritePos += numSamples;
+
+        if(subBlockWritePos >= subBlockLengthSamples)
+        {
+            const double subBlockSum = currentSubBlockSum;
+
+            currentSubBlockSum = 0.0;
+            subBlockWritePos = 0;
+
+            onSubBlockComplete(subBlockSum);
+        }
+    }
+
+    const size_t subBlockLengthSamples;
+
+    std::pmr::vector<ChannelProcessor> channelProcessors;
+
+    double currentSubBlockSum = 0.0;
+    size_t subBlockWritePos = 0;
+};
+
+}
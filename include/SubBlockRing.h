@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <memory_resource>
+#include <numeric>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace LUFS
+{
+
+//Holds the sums of squares of the most recent fixed length sub blocks (usually 100ms) so a window made of whole sub blocks can be read without storing samples
+class SubBlockRing
+{
+public:
+    SubBlockRing(size_t numSubBlocks, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource())  : subBlockSums(numSubBlocks, 0.0, memoryResource)
+    {
+        assert(numSubBlocks > 0);
+    }
+
+    //Length of a 100ms sub block at a sample rate, every meter steps in these so they line up with each other
+    static size_t getSubBlockLengthSamples(double sampleRate)
+    {
+        //Below this the K weighting shelf is above the nyquist frequency
+        if(!(sampleRate >= minSampleRate))
+        {
+            throw(std::runtime_error("Sample rate must be at least 8kHz"));
+        }
+
+        return static_cast<size_t>(std::round(sampleRate * (subBlockLengthMs / 1000.0)));
+    }
+
+    static constexpr int subBlockLengthMs = 100;
+    static constexpr double minSampleRate = 8000.0;
+
+    //Adds a completed sub block, replacing the oldest one
+    void push(double subBlockSum)
+    {
+        subBlockSums[writePos] = subBlockSum;
+
+        if(++writePos >= subBlockSums.size())
+        {
+            writePos = 0;
+        }
+
+        //The ring is small so this is cheap and means rounding errors can never build up
+        total = std::accumulate(subBlockSums.begin(), subBlockSums.end(), 0.0);
+
+        ++numPushed;
+    }
+
+    double getSum() const
+    {
+        return total;
+    }
+
+    //Sums the most recent sub blocks only, this must not be more than the size of the ring
+    double getSumOfLatest(size_t numSubBlocks) const
+    {
+        assert(numSubBlocks <= subBlockSums.size());
+
+        double sum = 0.0;
+        size_t readPos = writePos;
+
+        for(size_t subBlockIndex = 0; subBlockIndex < numSubBlocks; ++subBlockIndex)
+        {
+            readPos = (readPos == 0 ? subBlockSums.size() : readPos) - 1;
+            sum += subBlockSums[readPos];
+        }
+
+        return sum;
+    }
+
+    size_t size() const
+    {
+        return subBlockSums.size();
+    }
+
+    size_t getNumPushed() const
+    {
+        return numPushed;
+    }
+
+    //Is true once every sub block in the ring has been written at least once
+    bool isFull() const
+    {
+        return numPushed >= subBlockSums.size();
+    }
+
+    void reset()
+    {
+        std::fill(subBlockSums.begin(), subBlockSums.end(), 0.0);
+
+        writePos = 0;
+        total = 0.0;
+        numPushed = 0;
+    }
+
+private:
+    std::pmr::vector<double> subBlockSums;
+
+    size_t writePos = 0;
+    double total = 0.0;
+    size_t numPushed = 0;
+};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+namespace LUFS
+{
+
+//A fixed set of worker threads that share out batches of tasks
+//Each thread starts on its own contiguous range of a batch, so neighbouring tasks run on the same thread, and steals from the other ranges once its own runs out
+class ThreadPool
+{
+public:
+    //The calling thread also runs tasks so this starts one less worker than the number of threads, 0 uses the number of hardware threads
+    ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    //Runs the task for every index below numTasks and returns once they have all finished, this must not be called concurrently
+    //If any task throws the first exception is rethrown once all tasks have finished
+    void parallelFor(size_t numTasks, const std::function<void(size_t)>& task);
+
+    size_t getNumThreads() const;
+
+private:
+    //The tasks of a batch that one thread starts on, kept on separate cache lines so threads working through their own ranges don't contend
+    struct alignas(64) TaskRange
+    {
+        std::atomic<size_t> next = 0;
+        size_t end = 0;
+    };
+
+    void workerLoop(size_t threadIndex);
+    void runTasks(const std::function<void(size_t)>& task, size_t threadIndex);
+
+    //Takes the next task of this thread's range, or of another thread's if that is empty, returns false once every range is empty
+    bool claimTask(size_t threadIndex, size_t& taskIndex);
+
+    std::vector<std::thread> workers;
+
+    std::mutex stateLock;
+    std::condition_variable workAvailable;
+    std::condition_variable workFinished;
+
+    //All of these are protected by the state lock
+    const std::function<void(size_t)>* currentTask = nullptr;
+    size_t currentNumTasks = 0;
+    size_t numTasksFinished = 0;
+    size_t numActiveWorkers = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::exception_ptr firstException;
+
+    //One per thread, the calling thread's is first, the ends are set under the state lock before a batch starts
+    std::vector<TaskRange> taskRanges;
+};
+
+}
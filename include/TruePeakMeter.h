@@ -7,11 +7,11 @@
 #include <cstdint>
 #include <algorithm>
 #include <cmath>
-#include <mutex>
+#include <atomic>
+#include <memory_resource>
 
 #include "LiblufsAPI.h"
-#include "samplerate.h"
-#include "SpinLock.h"
+#include "TruePeakOversampler.h"
 
 namespace LUFS
 {
@@ -19,45 +19,65 @@ namespace LUFS
 class LIBLUFS_API TruePeakMeter
 {
 public:
-    //Buffers can come in smaller than this but must never exceed this number of samples per channel
-    TruePeakMeter(double sampleRate, int numChannels, int maxBufferSize, float minLevel = -100.0f);
+    //Rates below 88.2kHz are oversampled by 4, rates below 176.4kHz by 2 and higher rates aren't oversampled
+    //Buffers can be any length, they are processed in small chunks internally
+    //Everything the meter needs is allocated from the memory resource when it is constructed
+    TruePeakMeter(double sampleRate, int numChannels, float minLevel = -100.0f, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Kept so older code that passed both still builds, maxBufferSize is ignored
+    //Every argument is required so a min level written as an integer, such as -70, can only select the constructor above
+    [[deprecated("Buffers no longer have a maximum size, use the constructor without maxBufferSize")]]
+    TruePeakMeter(double sampleRate, int numChannels, int maxBufferSize, float minLevel);
     ~TruePeakMeter();
 
     //Deinterleaved and Interleaved
     void process(std::span<const float* const> audio, int numSamplesPerChannel);
     void process(std::span<const float> audio);
 
-    //This is not threadsafe with process calls
+    //This is threadsafe with process calls and never blocks, the peaks read as cleared straight away
+    //The peaks and filter state are cleared by the next process call, which is the only thing that writes them, so no audio goes unmeasured
     void reset();
 
-    //This is threadsafe with process calls
+    //These are threadsafe with process calls, without a channel index they return the largest of every channel
     float getTruePeak() const;
+    float getTruePeak(int channelIndex) const;
+    float getSamplePeak() const;
+    float getSamplePeak(int channelIndex) const;
+
+    int getOversamplingFactor() const;
 
 private:
-    const float min;
+    static size_t calculateOversamplingFactor(double sampleRate);
 
-    void process();
+    void publishPeaks(int channelIndex, const TruePeakOversampler::Peaks& peaks);
 
-    const int expectedNumChannels;
-    const int bufferSizeLimit;
-    static constexpr double targetSampleRate = 192000.0;
-    const double sampleRateConversionRatio;
+    //Called at the start of every process call
+    void applyPendingReset();
+    void clearPeaks();
+
+    //Peaks read as cleared between a reset call and the process call that applies it
+    bool isResetPending() const;
 
-    SRC_STATE* sampleRateConverter = nullptr;
-    SRC_DATA sampleRateConverterState;
+    static float findLargest(const std::pmr::vector<std::atomic<float>>& channelPeaks);
+    float convertToDecibels(float gain) const;
 
-    std::vector<float> conversionInputBuffer;
-    std::vector<float> conversionOutputBuffer;
+    const float min;
+
+    const int expectedNumChannels;
 
-    //-12.04dB in gain
-    static constexpr float inputGain = 0.2491f;
+    //Built in rather than a general resampler since only the peak of the oversampled signal is needed
+    TruePeakOversampler oversampler;
 
-    //12.04dB in gain
-    static constexpr float outputGain = 3.999f;
+    //Both peaks are found in the same pass over each channel
+    std::pmr::vector<std::atomic<float>> channelTruePeakGains;
+    std::pmr::vector<std::atomic<float>> channelSamplePeakGains;
 
-    std::atomic<float> currentTruePeakGain = 0.0f;
+    //The peaks of each channel of an interleaved block, allocated up front so processing doesn't allocate
+    std::pmr::vector<TruePeakOversampler::Peaks> interleavedBlockPeaks;
 
-    SpinLock resetLock;
+    //Each reset call adds one, the process thread resets its own state when it sees a count it hasn't applied
+    std::atomic<uint64_t> numResetsRequested = 0;
+    std::atomic<uint64_t> numResetsApplied = 0;
 };
 
 }
\ No newline at end of file
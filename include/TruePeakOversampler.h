@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cassert>
+#include <span>
+#include <memory_resource>
+
+namespace LUFS
+{
+
+//Interpolates audio with the 48 tap polyphase filter from ITU-R BS.1770 Annex 2, only the peak of the interpolated signal is kept
+//Oversampling by 4 uses every phase of the filter, by 2 uses every other phase and by 1 just finds the sample peak
+class TruePeakOversampler
+{
+public:
+    TruePeakOversampler(size_t numChannels, size_t oversamplingFactor, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+    //Largest absolute values of a block, both are found in the same pass
+    struct Peaks
+    {
+        float truePeak = 0.0f;
+        float samplePeak = 0.0f;
+    };
+
+    //Returns the peaks of the interpolated samples and of the samples themselves of a block of one channel
+    //The samples are read where they are, only the first few outputs of a block need the previous block's samples copied alongside them
+    Peaks process(size_t channelIndex, const float* samples, size_t numSamples);
+
+    //Interleaved audio is deinterleaved a chunk at a time, the peaks of each channel are written to channelPeaks
+    void process(std::span<const float> audio, std::span<Peaks> channelPeaks);
+
+    void reset();
+
+    size_t getOversamplingFactor() const;
+
+    static constexpr size_t numPhases = 4;
+    static constexpr size_t tapsPerPhase = 12;
+
+private:
+    //Output n is the inner product of each phase with input[n] to input[n + historyLength]
+    template<size_t numActivePhases>
+    Peaks processContiguous(const float* input, size_t numOutputs) const;
+
+    //Uses the instantiation for the oversampling factor
+    Peaks processContiguous(const float* input, size_t numOutputs) const;
+
+    static float findSamplePeak(const float* samples, size_t numSamples);
+
+    //Writes numFrames of every channel to planar, channel c starting at planar + c * planarStride
+    static void deinterleave(const float* interleaved, size_t numChannels, size_t numFrames, float* planar, size_t planarStride);
+
+    const size_t numInputChannels;
+    const size_t factor;
+
+    //The phases in use, evenly spaced through the filter
+    std::array<std::array<float, tapsPerPhase>, numPhases> activePhases;
+
+    //The last samples of each channel, enough for the first outputs of the next block
+    static constexpr size_t historyLength = tapsPerPhase - 1;
+    std::pmr::vector<float> channelHistories;
+
+    //The history followed by the first samples of a block, which is all the first historyLength outputs need
+    std::array<float, historyLength * 2> stitchBuffer;
+
+    //Deinterleaved chunks of every channel, small enough to stay in the L1 cache alongside the coefficients
+    static constexpr size_t chunkLengthSamples = 1024;
+    const size_t chunkLengthFrames;
+    std::pmr::vector<float> deinterleaveBuffer;
+
+    //Each phase reversed so that output n is the inner product of the phase with the input starting at n
+    static const std::array<std::array<float, tapsPerPhase>, numPhases> reversedPhases;
+};
+
+}
@@ -3,9 +3,9 @@
 namespace LUFS
 {
 
-ChannelProcessor::ChannelProcessor(float channelWeighting, size_t blockSizeSamples)  : weighting{channelWeighting}, currentBlockData(blockSizeSamples, 0.0f)
+ChannelProcessor::ChannelProcessor(float channelWeighting, size_t blockSizeSamples, double sampleRate, std::pmr::memory_resource* memoryResource)  : weighting{channelWeighting}, currentBlockData(blockSizeSamples, 0.0f, memoryResource)
 {
-    initialiseFilters();
+    initialiseFilters(sampleRate);
 
     std::fill(currentBlockData.begin(), currentBlockData.end(), 0.0f);
 }
@@ -20,12 +20,72 @@ float ChannelProcessor::filterSample(float sample)
     return filt2.processSample(filt1.processSample(sample));
 }
 
+double ChannelProcessor::filterBlock(std::span<const float> samples)
+{
+    KWeightingKernel::LaneState state = getKernelState();
+    double sumSquares = 0.0;
+
+    KWeightingKernel::process(getKernelCoefficients(), &state, samples.data(), 1, 1, samples.size(), &sumSquares, nullptr);
+
+    setKernelState(state);
+
+    return sumSquares;
+}
+
+double ChannelProcessor::filterInterleaved(std::span<ChannelProcessor> processors, std::span<const float> audio)
+{
+    const size_t numChannels = processors.size();
+
+    assert(numChannels > 0);
+    assert(audio.size() % numChannels == 0);
+
+    const size_t numFrames = audio.size() / numChannels;
+
+    //Every channel shares the same coefficients
+    const KWeightingKernel::Coefficients coefficients = processors.front().getKernelCoefficients();
+
+    double weightedSumSquares = 0.0;
+
+    for(size_t firstChannel = 0; firstChannel < numChannels; firstChannel += maxKernelLanes)
+    {
+        const size_t numLanes = std::min(maxKernelLanes, numChannels - firstChannel);
+
+        std::array<KWeightingKernel::LaneState, maxKernelLanes> states;
+        std::array<double, maxKernelLanes> sumsOfSquares{};
+
+        for(size_t lane = 0; lane < numLanes; ++lane)
+        {
+            states[lane] = processors[firstChannel + lane].getKernelState();
+        }
+
+        KWeightingKernel::process(coefficients, states.data(), audio.data() + firstChannel, numChannels, numLanes, numFrames, sumsOfSquares.data(), nullptr);
+
+        for(size_t lane = 0; lane < numLanes; ++lane)
+        {
+            ChannelProcessor& processor = processors[firstChannel + lane];
+
+            processor.setKernelState(states[lane]);
+            weightedSumSquares += processor.getWeighting() * sumsOfSquares[lane];
+        }
+    }
+
+    return weightedSumSquares;
+}
+
+KWeightingKernel::Coefficients ChannelProcessor::calculateKernelCoefficients(double sampleRate)
+{
+    return ChannelProcessor(1.0f, 0, sampleRate).getKernelCoefficients();
+}
+
 void ChannelProcessor::reset()
 {
     filt1.reset();
     filt2.reset();
 
     std::fill(currentBlockData.begin(), currentBlockData.end(), 0.0f);
+
+    runningSumSquares = 0.0;
+    freshSumSquares = 0.0;
 }
 
 float ChannelProcessor::getCurrentBlockMeanSquares() const
@@ -42,19 +102,83 @@ float ChannelProcessor::getCurrentBlockMeanSquares() const
     return meanSquares;
 }
 
-void ChannelProcessor::initialiseFilters()
+void ChannelProcessor::storeSample(size_t blockIndex, float filteredSample)
 {
-    filt1.a1 = -1.69065929318241;
-    filt1.a2 = 0.73248077421585;
-    filt1.b0 = 1.53512485958697;
-    filt1.b1 = -2.69169618940638;
-    filt1.b2 = 1.19839281085285;
-    
-    filt2.a1 = -1.99004745483398;
-    filt2.a2 = 0.99007225036621;
+    assert(blockIndex < currentBlockData.size());
+
+    //Squares of floats are exact in double precision
+    const double newSquare = double(filteredSample) * double(filteredSample);
+    const double oldSquare = double(currentBlockData[blockIndex]) * double(currentBlockData[blockIndex]);
+
+    currentBlockData[blockIndex] = filteredSample;
+
+    runningSumSquares += newSquare - oldSquare;
+    freshSumSquares += newSquare;
+
+    //Every sample in the block has been rewritten since the last wrap so the fresh sum now covers the whole block
+    if(blockIndex == currentBlockData.size() - 1)
+    {
+        runningSumSquares = freshSumSquares;
+        freshSumSquares = 0.0;
+    }
+}
+
+float ChannelProcessor::getRunningBlockMeanSquares() const
+{
+    return std::max(0.0, runningSumSquares) / currentBlockData.size();
+}
+
+void ChannelProcessor::initialiseFilters(double sampleRate)
+{
+    //The analogue prototypes of both stages, at 48kHz these give the coefficients published in the recommendation
+    constexpr double pi = 3.14159265358979323846;
+
+    constexpr double shelfFrequency = 1681.974450955533;
+    constexpr double shelfGainDb = 3.999843853973347;
+    constexpr double shelfQ = 0.7071752369554196;
+
+    constexpr double highPassFrequency = 38.13547087602444;
+    constexpr double highPassQ = 0.5003270373238773;
+
+    const double shelfK = std::tan(pi * shelfFrequency / sampleRate);
+    const double shelfVh = std::pow(10.0, shelfGainDb / 20.0);
+    const double shelfVb = std::pow(shelfVh, 0.4996667741545416);
+    const double shelfA0 = 1.0 + shelfK / shelfQ + shelfK * shelfK;
+
+    filt1.a1 = 2.0 * (shelfK * shelfK - 1.0) / shelfA0;
+    filt1.a2 = (1.0 - shelfK / shelfQ + shelfK * shelfK) / shelfA0;
+    filt1.b0 = (shelfVh + shelfVb * shelfK / shelfQ + shelfK * shelfK) / shelfA0;
+    filt1.b1 = 2.0 * (shelfK * shelfK - shelfVh) / shelfA0;
+    filt1.b2 = (shelfVh - shelfVb * shelfK / shelfQ + shelfK * shelfK) / shelfA0;
+
+    const double highPassK = std::tan(pi * highPassFrequency / sampleRate);
+    const double highPassA0 = 1.0 + highPassK / highPassQ + highPassK * highPassK;
+
+    filt2.a1 = 2.0 * (highPassK * highPassK - 1.0) / highPassA0;
+    filt2.a2 = (1.0 - highPassK / highPassQ + highPassK * highPassK) / highPassA0;
     filt2.b0 = 1.0;
     filt2.b1 = -2.0;
     filt2.b2 = 1.0;
 }
 
+KWeightingKernel::Coefficients ChannelProcessor::getKernelCoefficients() const
+{
+    KWeightingKernel::Coefficients coefficients;
+    coefficients.shelf = KWeightingKernel::Stage{filt1.a1, filt1.a2, filt1.b0, filt1.b1, filt1.b2};
+    coefficients.highPass = KWeightingKernel::Stage{filt2.a1, filt2.a2, filt2.b0, filt2.b1, filt2.b2};
+
+    return coefficients;
+}
+
+KWeightingKernel::LaneState ChannelProcessor::getKernelState() const
+{
+    return KWeightingKernel::LaneState{filt1.getPrev(), filt1.getLast(), filt2.getPrev(), filt2.getLast()};
+}
+
+void ChannelProcessor::setKernelState(const KWeightingKernel::LaneState& state)
+{
+    filt1.setState(state.shelfPrev, state.shelfLast);
+    filt2.setState(state.highPassPrev, state.highPassLast);
+}
+
 }
\ No newline at end of file
@@ -3,9 +3,17 @@
 namespace LUFS
 {
     
-FixedTermLoudnessMeter::FixedTermLoudnessMeter(const std::vector<Channel>& channelSet, const std::chrono::milliseconds& windowLength, float minLevel)  : channels{channelSet}, blockLengthSamples{getBlockLengthSamples(windowLength)}, min{minLevel}, channelProcessors{generateChannelProcessors()}
+FixedTermLoudnessMeter::FixedTermLoudnessMeter(double sampleRate, const std::vector<Channel>& channelSet, const std::chrono::milliseconds& windowLength, float minLevel, Resolution windowResolution, std::pmr::memory_resource* memoryResource)  : sampleRate{sampleRate}, subBlockLengthSamples{SubBlockRing::getSubBlockLengthSamples(sampleRate)}, min{minLevel}, resolution{windowResolution}, blockLengthSamples{getBlockLengthSamples(windowLength)}, channelProcessors{generateChannelProcessors(channelSet, memoryResource)}, subBlocks{getNumSubBlocks(), memoryResource}, summary{Summary{}}
 {
-    
+    if(resolution == Resolution::SubBlock && (windowLength.count() <= 0 || windowLength.count() % SubBlockRing::subBlockLengthMs != 0))
+    {
+        throw(std::runtime_error("Window length must be a multiple of the sub block length"));
+    }
+}
+
+FixedTermLoudnessMeter::FixedTermLoudnessMeter(const std::vector<Channel>& channelSet, const std::chrono::milliseconds& windowLength, float minLevel, Resolution windowResolution, std::pmr::memory_resource* memoryResource)  : FixedTermLoudnessMeter(defaultSampleRate, channelSet, windowLength, minLevel, windowResolution, memoryResource)
+{
+
 }
 
 FixedTermLoudnessMeter::~FixedTermLoudnessMeter()
@@ -15,118 +23,202 @@ FixedTermLoudnessMeter::~FixedTermLoudnessMeter()
 
 void FixedTermLoudnessMeter::process(std::span<const float* const> audio, int numSamplesPerChannel)
 {
-    std::vector<ChannelProcessor>& processors = channelProcessors.realtimeAquire();
+    assert(audio.size() == channelProcessors.size());
+    assert(numSamplesPerChannel >= 0);
 
-    assert(audio.size() == processors.size());
-    
-    for(size_t sampleIndex = 0; sampleIndex < numSamplesPerChannel; ++sampleIndex)
+    const size_t numSamples = static_cast<size_t>(numSamplesPerChannel);
+
+    //Only sums of squares are needed for each sub block so each channel can be filtered a block at a time
+    if(resolution == Resolution::SubBlock)
     {
-        for(int channelIndex = 0; channelIndex < processors.size(); ++channelIndex)
+        size_t bufferReadPos = 0;
+
+        while(bufferReadPos < numSamples)
         {
-            processors[channelIndex].currentBlockData[blockWritePos] =  processors[channelIndex].filterSample(audio[channelIndex][sampleIndex]);
+            const size_t numSamplesToAdd = std::min(subBlockLengthSamples - blockWritePos, numSamples - bufferReadPos);
+
+            for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
+            {
+                ChannelProcessor& channelProcessor = channelProcessors[channelIndex];
+                currentSubBlockSum += channelProcessor.getWeighting() * channelProcessor.filterBlock({audio[channelIndex] + bufferReadPos, numSamplesToAdd});
+            }
+
+            advanceSubBlockWritePos(numSamplesToAdd);
+            bufferReadPos += numSamplesToAdd;
         }
 
-        if(++blockWritePos >= blockLengthSamples)
+        publishSummary();
+
+        return;
+    }
+    
+    for(size_t sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+    {
+        for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
         {
-            blockWritePos = 0;
+            addSample(channelIndex, audio[channelIndex][sampleIndex]);
         }
+
+        advanceWritePos();
     }
 
-    channelProcessors.realtimeRelease();
+    publishSummary();
 }
 
 void FixedTermLoudnessMeter::process(std::span<const float> audio)
 {
-    std::vector<ChannelProcessor>& processors = channelProcessors.realtimeAquire();
+    assert(audio.size() % channelProcessors.size() == 0);
+
+    const size_t numChannels = channelProcessors.size();
+    const size_t numSamplesPerChannel = audio.size() / numChannels;
 
-    assert(audio.size() % processors.size() == 0);
+    //Only sums of squares are needed for each sub block so every channel can be filtered together
+    if(resolution == Resolution::SubBlock)
+    {
+        size_t bufferReadPos = 0;
+
+        while(bufferReadPos < numSamplesPerChannel)
+        {
+            const size_t numSamplesToAdd = std::min(subBlockLengthSamples - blockWritePos, numSamplesPerChannel - bufferReadPos);
+
+            currentSubBlockSum += ChannelProcessor::filterInterleaved(channelProcessors, audio.subspan(bufferReadPos * numChannels, numSamplesToAdd * numChannels));
+
+            advanceSubBlockWritePos(numSamplesToAdd);
+            bufferReadPos += numSamplesToAdd;
+        }
+
+        publishSummary();
 
-    const size_t numSamplesPerChannel = audio.size() / processors.size();
+        return;
+    }
     
     const float* inputData = audio.data();
 
     for(size_t sampleIndex = 0; sampleIndex < numSamplesPerChannel; ++sampleIndex)
     {
-        for(int channelIndex = 0; channelIndex < processors.size(); ++channelIndex)
+        for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
         {
-            processors[channelIndex].currentBlockData[blockWritePos] = processors[channelIndex].filterSample(*inputData++);
+            addSample(channelIndex, *inputData++);
         }
 
-        if(++blockWritePos >= blockLengthSamples)
-        {
-            blockWritePos = 0;
-        }
+        advanceWritePos();
     }
 
-    channelProcessors.realtimeRelease();
+    publishSummary();
 }
 
 void FixedTermLoudnessMeter::reset()
 {
-    channelProcessors.reset(generateChannelProcessors());
+    std::for_each(channelProcessors.begin(), channelProcessors.end(), [](ChannelProcessor& processor)
+    {
+        processor.reset();
+    });
+
+    subBlocks.reset();
+    summary.publish(Summary{});
     
     blockWritePos = 0;
+    currentSubBlockSum = 0.0;
 }
 
 float FixedTermLoudnessMeter::getLoudnessRealtime()
 {
-    const std::vector<ChannelProcessor>& processors = channelProcessors.realtimeAquire();
-
-    float accumulatedChannels = 0.0f;
+    return convertToLoudness(calculateWeightedMeanSquares());
+}
 
-    std::for_each(processors.begin(), processors.end(), [&accumulatedChannels](const ChannelProcessor& processor)
-    {
-        accumulatedChannels += processor.getCurrentBlockMeanSquares() * processor.getWeighting();
-    });
+float FixedTermLoudnessMeter::getLoudness() const
+{
+    return convertToLoudness(summary.read().weightedMeanSquares);
+}
 
-    if(accumulatedChannels == 0.0f)
+int FixedTermLoudnessMeter::getBlockLengthSamples(const std::chrono::milliseconds& windowLength) const
+{
+    //Whole sub blocks so the window always covers the same audio as the sub blocks it is made of
+    if(resolution == Resolution::SubBlock)
     {
-        return min;
+        return static_cast<int>((windowLength.count() / SubBlockRing::subBlockLengthMs) * subBlockLengthSamples);
     }
 
-    float loudness = -0.691f + 10.0f * std::log10(accumulatedChannels);
+    return static_cast<int>(std::round((windowLength.count() / 1000.0) * sampleRate));
+}
+
+size_t FixedTermLoudnessMeter::getNumSubBlocks() const
+{
+    return std::max(static_cast<size_t>(blockLengthSamples) / subBlockLengthSamples, size_t(1));
+}
 
-    channelProcessors.realtimeRelease();
+void FixedTermLoudnessMeter::addSample(size_t channelIndex, float sample)
+{
+    ChannelProcessor& processor = channelProcessors[channelIndex];
 
-    return loudness;
+    processor.storeSample(blockWritePos, processor.filterSample(sample));
 }
 
-float FixedTermLoudnessMeter::getLoudness() const
+void FixedTermLoudnessMeter::advanceWritePos()
 {
-    std::scoped_lock<std::mutex> lock{channelProcessorsOfflineLock};
+    if(++blockWritePos >= static_cast<size_t>(blockLengthSamples))
+    {
+        blockWritePos = 0;
+    }
+}
 
-    const std::vector<ChannelProcessor>& processors = channelProcessors.nonRealtimeRead();
+void FixedTermLoudnessMeter::advanceSubBlockWritePos(size_t numSamples)
+{
+    blockWritePos += numSamples;
 
-    float accumulatedChannels = 0.0f;
+    if(blockWritePos >= subBlockLengthSamples)
+    {
+        subBlocks.push(currentSubBlockSum);
 
-    std::for_each(processors.begin(), processors.end(), [&accumulatedChannels](const ChannelProcessor& processor)
+        currentSubBlockSum = 0.0;
+        blockWritePos = 0;
+    }
+}
+    
+std::pmr::vector<ChannelProcessor> FixedTermLoudnessMeter::generateChannelProcessors(const std::vector<Channel>& channelSet, std::pmr::memory_resource* memoryResource) const
+{
+    std::pmr::vector<ChannelProcessor> tempChannelProcessors{memoryResource};
+    tempChannelProcessors.reserve(channelSet.size());
+
+    std::transform(channelSet.begin(), channelSet.end(), std::back_insert_iterator(tempChannelProcessors), [this, memoryResource](const Channel& channel)
     {
-        accumulatedChannels += processor.getCurrentBlockMeanSquares() * processor.getWeighting();
+        //Samples are only stored when the window moves every sample
+        return ChannelProcessor(channel.getWeighting(), resolution == Resolution::Sample ? blockLengthSamples : 0, sampleRate, memoryResource);
     });
 
-    if(accumulatedChannels == 0.0f)
+    return tempChannelProcessors;
+}
+
+double FixedTermLoudnessMeter::calculateWeightedMeanSquares() const
+{
+    if(resolution == Resolution::SubBlock)
     {
-        return min;
+        return subBlocks.getSum() / blockLengthSamples;
     }
 
-    return -0.691f + 10.0f * std::log10(accumulatedChannels);
+    double accumulatedChannels = 0.0;
+
+    std::for_each(channelProcessors.begin(), channelProcessors.end(), [&accumulatedChannels](const ChannelProcessor& processor)
+    {
+        accumulatedChannels += processor.getRunningBlockMeanSquares() * processor.getWeighting();
+    });
+
+    return accumulatedChannels;
 }
 
-int FixedTermLoudnessMeter::getBlockLengthSamples(const std::chrono::milliseconds& windowLength) const
+void FixedTermLoudnessMeter::publishSummary()
 {
-    return (windowLength.count() / 1000.0f) * sampleRate;
+    summary.publish(Summary{calculateWeightedMeanSquares()});
 }
-    
-std::vector<ChannelProcessor> FixedTermLoudnessMeter::generateChannelProcessors() const
-{
-    std::vector<ChannelProcessor> tempChannelProcessors;
 
-    std::transform(channels.begin(), channels.end(), std::back_insert_iterator(tempChannelProcessors), [this](const Channel& channel)
+float FixedTermLoudnessMeter::convertToLoudness(double weightedMeanSquares) const
+{
+    if(weightedMeanSquares == 0.0)
     {
-        return ChannelProcessor(channel.getWeighting(), blockLengthSamples);
-    });
+        return min;
+    }
 
-    return tempChannelProcessors;
+    return -0.691f + 10.0f * std::log10(weightedMeanSquares);
 }
 
 }
@@ -3,14 +3,20 @@
 namespace LUFS
 {
     
-IntegratedLoudnessMeter::IntegratedLoudnessMeter(const std::vector<Channel>& channels, float minLevel)  : min{minLevel}, processBlock{channels.size()}, blockHistogram{generateBlankHistogram(channels.size())}
+IntegratedLoudnessMeter::IntegratedLoudnessMeter(double sampleRate, const std::vector<Channel>& channels, float minLevel, std::pmr::memory_resource* memoryResource)  : min{minLevel}, subBlockLengthSamples{SubBlockRing::getSubBlockLengthSamples(sampleRate)}, blockLengthSamples{subBlockLengthSamples * numSubBlocksPerBlock}, channelProcessors{memoryResource}, subBlocks{numSubBlocksPerBlock, memoryResource}, blockHistogram{memoryResource}
 {
-    std::transform(channels.begin(), channels.end(), std::back_insert_iterator(channelProcessors), [this](const Channel& channel)
+    channelProcessors.reserve(channels.size());
+
+    std::transform(channels.begin(), channels.end(), std::back_insert_iterator(channelProcessors), [sampleRate, memoryResource](const Channel& channel)
     {
-        return ChannelProcessor(channel.getWeighting(), blockLengthSamples);
+        //Only sums of squares are kept so no samples need storing
+        return ChannelProcessor(channel.getWeighting(), 0, sampleRate, memoryResource);
     });
-    
-    histogramMappingSlope = (numHistogramElements - 1.0f) / (highestIntegratedValue - lowestIntegratedValue);
+}
+
+IntegratedLoudnessMeter::IntegratedLoudnessMeter(const std::vector<Channel>& channels, float minLevel, std::pmr::memory_resource* memoryResource)  : IntegratedLoudnessMeter(defaultSampleRate, channels, minLevel, memoryResource)
+{
+
 }
 
 IntegratedLoudnessMeter::~IntegratedLoudnessMeter()
@@ -22,7 +28,7 @@ void IntegratedLoudnessMeter::process(std::span<const float* const> audio, int n
 {
     assert(audio.size() == channelProcessors.size());
     
-    size_t numSamplesToAdd = std::min(blockLengthSamples - currentBlockWritePos, static_cast<size_t>(numSamplesPerChannel));
+    size_t numSamplesToAdd = std::min(subBlockLengthSamples - currentSubBlockWritePos, static_cast<size_t>(numSamplesPerChannel));
     int bufferReadPos = 0;
     
     while(numSamplesToAdd > 0)
@@ -30,19 +36,17 @@ void IntegratedLoudnessMeter::process(std::span<const float* const> audio, int n
         for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
         {
             ChannelProcessor& channelProcessor = channelProcessors[channelIndex];
-            std::vector<float>& channelCurrentBlock = channelProcessor.currentBlockData; 
-            const float* const channelData = audio[channelIndex];
-            
-            //Add samples to the channels current block, filtering each one
-            std::transform(channelData + bufferReadPos, channelData + bufferReadPos + numSamplesToAdd, channelCurrentBlock.begin() + currentBlockWritePos, std::bind(&ChannelProcessor::filterSample, &channelProcessor, std::placeholders::_1));
+
+            //Filter the channels samples and add its weighted sum of squares
+            currentSubBlockSum += channelProcessor.getWeighting() * channelProcessor.filterBlock({audio[channelIndex] + bufferReadPos, numSamplesToAdd});
         }
         
-        currentBlockWritePos += numSamplesToAdd;
+        currentSubBlockWritePos += numSamplesToAdd;
         
         //Check if we're ready to process
-        if(currentBlockWritePos >= blockLengthSamples)
+        if(currentSubBlockWritePos >= subBlockLengthSamples)
         {
-            processCurrentBlock();
+            processCurrentSubBlock();
         }
         
         //Check if we can add/process more data
@@ -50,7 +54,7 @@ void IntegratedLoudnessMeter::process(std::span<const float* const> audio, int n
         
         if(bufferReadPos < numSamplesPerChannel)
         {
-            numSamplesToAdd = std::min(blockLengthSamples - currentBlockWritePos, static_cast<size_t>(numSamplesPerChannel - bufferReadPos));
+            numSamplesToAdd = std::min(subBlockLengthSamples - currentSubBlockWritePos, static_cast<size_t>(numSamplesPerChannel - bufferReadPos));
         }
         else
         {
@@ -65,31 +69,20 @@ void IntegratedLoudnessMeter::process(std::span<const float> audio)
 
     size_t numSamplesPerChannel = audio.size() / channelProcessors.size();
     
-    size_t numSamplesToAdd = std::min(blockLengthSamples - currentBlockWritePos, static_cast<size_t>(numSamplesPerChannel));
+    size_t numSamplesToAdd = std::min(subBlockLengthSamples - currentSubBlockWritePos, static_cast<size_t>(numSamplesPerChannel));
     int bufferReadPos = 0;
     
     while(numSamplesToAdd > 0)
     {
-        //Copy the samples to the channel buffers filtering each one
-        for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
-        {
-            ChannelProcessor& channelProcessor = channelProcessors[channelIndex];
-            std::vector<float>& channelCurrentBlock = channelProcessor.currentBlockData; 
-            
-            for(size_t sampleIndex = 0; sampleIndex < numSamplesToAdd; ++sampleIndex)
-            {
-                const size_t fullSampleIndex = sampleIndex + bufferReadPos;
-                const float sample = audio[fullSampleIndex * channelProcessors.size() + channelIndex];
-                channelCurrentBlock[currentBlockWritePos + sampleIndex] = channelProcessor.filterSample(sample);
-            }
-        }
+        //Filter every channel together and add their weighted sums of squares
+        currentSubBlockSum += ChannelProcessor::filterInterleaved(channelProcessors, audio.subspan(bufferReadPos * channelProcessors.size(), numSamplesToAdd * channelProcessors.size()));
         
-        currentBlockWritePos += numSamplesToAdd;
+        currentSubBlockWritePos += numSamplesToAdd;
         
         //Check if we're ready to process
-        if(currentBlockWritePos >= blockLengthSamples)
+        if(currentSubBlockWritePos >= subBlockLengthSamples)
         {
-            processCurrentBlock();
+            processCurrentSubBlock();
         }
         
         //Check if we can add/process more data
@@ -97,7 +90,7 @@ void IntegratedLoudnessMeter::process(std::span<const float> audio)
         
         if(bufferReadPos < numSamplesPerChannel)
         {
-            numSamplesToAdd = std::min(blockLengthSamples - currentBlockWritePos, static_cast<size_t>(numSamplesPerChannel - bufferReadPos));
+            numSamplesToAdd = std::min(subBlockLengthSamples - currentSubBlockWritePos, static_cast<size_t>(numSamplesPerChannel - bufferReadPos));
         }
         else
         {
@@ -113,124 +106,50 @@ void IntegratedLoudnessMeter::reset()
         processor.reset();
     });
     
-    blockHistogram.reset(generateBlankHistogram(channelProcessors.size()));
+    blockHistogram.clear();
 
-    currentBlockWritePos = 0;
+    subBlocks.reset();
+    currentSubBlockSum = 0.0;
+    currentSubBlockWritePos = 0;
 }
 
-float IntegratedLoudnessMeter::getLoudnessRealtime()
+void IntegratedLoudnessMeter::resetIntegration()
 {
-    const std::vector<HistogramBlock>& histogram = blockHistogram.realtimeAquire();
-    
-    float relativeThreshold = calculateLoudnessWithThreshold(histogram, gateAbsoluteThreshold);
-    float loudness = calculateLoudnessWithThreshold(histogram, relativeThreshold - 10.0f);
-
-    blockHistogram.realtimeRelease();
-
-    return loudness;
+    blockHistogram.clear();
 }
 
-float IntegratedLoudnessMeter::getLoudness() const
+float IntegratedLoudnessMeter::getLoudnessRealtime()
 {
-    std::scoped_lock<std::mutex> lock{histogramOfflineLock};
-
-    const std::vector<HistogramBlock>& histogram = blockHistogram.nonRealtimeRead();
-    
-    float relativeThreshold = calculateLoudnessWithThreshold(histogram, gateAbsoluteThreshold);
-    return calculateLoudnessWithThreshold(histogram, relativeThreshold - 10.0f);
+    return getLoudness();
 }
 
-void IntegratedLoudnessMeter::processCurrentBlock()
+float IntegratedLoudnessMeter::getLoudness() const
 {
-    for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
-    {
-        ChannelProcessor& channelProcessor = channelProcessors[channelIndex];
-        std::vector<float>& channelCurrentBlock = channelProcessor.currentBlockData; 
-        
-        //Process mean squares for channel
-        processBlock.channelMeanSquares[channelIndex] = channelProcessor.getCurrentBlockMeanSquares();
-        
-        //Move current block back by overlap samples
-        std::copy(channelCurrentBlock.begin() + overlapLengthSamples, channelCurrentBlock.end(), channelCurrentBlock.begin());
-    }
-    
-    calculateBlockLoudness(processBlock);
-
-    //Ignore loudness values that won't fit into our histogram
-    if(processBlock.loudness > lowestIntegratedValue && processBlock.loudness < highestIntegratedValue)
-    {
-        std::vector<HistogramBlock>& histogram = blockHistogram.realtimeAquire();
-
-        HistogramBlock& histBlock = histogram[getHistogramBinIndexForLoudness(processBlock.loudness)];
-        histBlock.addBlock(processBlock);
-
-        blockHistogram.realtimeRelease();
-    }
-    
-    //Move write pos back to overlap samples
-    currentBlockWritePos = blockLengthSamples - overlapLengthSamples;
+    return blockHistogram.calculateGatedLoudness(gateRelativeThreshold).value_or(min);
 }
 
-void IntegratedLoudnessMeter::calculateBlockLoudness(Block& block) const
+LoudnessHistogramState IntegratedLoudnessMeter::getState() const
 {
-    assert(block.channelMeanSquares.size() == channelProcessors.size());
-    
-    float currentTotal = 0.0f;
-    
-    for(size_t channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
-    {
-        currentTotal += channelProcessors[channelIndex].getWeighting() * block.channelMeanSquares[channelIndex]; 
-    }
-    
-    block.loudness = -0.691f + 10 * std::log10(currentTotal);
+    return blockHistogram.getState();
 }
 
-size_t IntegratedLoudnessMeter::getHistogramBinIndexForLoudness(float loudness) const
+float IntegratedLoudnessMeter::calculateLoudness(const LoudnessHistogramState& state, float minLevel)
 {
-    return std::min(numHistogramElements - 1, std::max(size_t(0), size_t(std::round(histogramMappingSlope * (loudness - lowestIntegratedValue)))));
+    return state.calculateGatedLoudness(gateRelativeThreshold).value_or(minLevel);
 }
 
-std::vector<HistogramBlock> IntegratedLoudnessMeter::generateBlankHistogram(size_t numChannels) const
+void IntegratedLoudnessMeter::processCurrentSubBlock()
 {
-    return std::vector<HistogramBlock>(numHistogramElements, HistogramBlock{numChannels});
-}
+    subBlocks.push(currentSubBlockSum);
 
-double IntegratedLoudnessMeter::calculateLoudnessWithThreshold(const std::vector<HistogramBlock>& histogram, const std::optional<float>& threshold) const
-{
-    float channelAccum = 0.0f;
-        
-    for(int channelIndex = 0; channelIndex < channelProcessors.size(); ++channelIndex)
-    {
-        float meanSquaresAccum = 0.0f;
-        size_t numBlocksAccum = 0;
-            
-        const size_t firstBinIndex = threshold ? getHistogramBinIndexForLoudness(*threshold) : size_t(0);
-            
-        std::for_each(histogram.begin() + firstBinIndex, histogram.end(), [&](const HistogramBlock& block)
-        {
-            if(block.numBlocks == 0)
-            {
-                return;
-            }
-                
-            meanSquaresAccum += block.accumulatedChannelMeanSquares[channelIndex];
-            numBlocksAccum += block.numBlocks;
-        });
-
-        if(numBlocksAccum ==  0)
-        {
-            continue;
-        }
-            
-        channelAccum += channelProcessors[channelIndex].getWeighting() * ((1.0f / float(numBlocksAccum)) * meanSquaresAccum);
-    }
+    currentSubBlockSum = 0.0;
+    currentSubBlockWritePos = 0;
 
-    if(channelAccum == 0.0f)
+    //Every sub block completes an overlapping gating block once there have been enough of them
+    if(subBlocks.isFull())
     {
-        return (double)min;
+        blockHistogram.addBlock(subBlocks.getSum() / blockLengthSamples);
     }
-        
-    return -0.691 + 10 * std::log10(channelAccum);
 }
 
 }
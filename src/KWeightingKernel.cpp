@@ -0,0 +1,185 @@
+#include "KWeightingKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LUFS_KWEIGHTING_X86_64
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace LUFS
+{
+
+void KWeightingKernel::process(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    process(getInstructionSet(), coefficients, states, input, stride, numLanes, numFrames, sumsOfSquares, output);
+}
+
+void KWeightingKernel::process(InstructionSet instructionSet, const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    assert(instructionSet <= getInstructionSet());
+
+    size_t lane = 0;
+
+    //Widest first, whatever is left over goes to the narrower kernels
+    if(instructionSet == InstructionSet::AVX2)
+    {
+        lane = processAVX2(coefficients, states, input, stride, numLanes, numFrames, sumsOfSquares, output);
+    }
+
+    if(instructionSet != InstructionSet::Scalar)
+    {
+        const size_t numPairedLanes = ((numLanes - lane) / 2) * 2;
+        processSSE2(coefficients, states + lane, input + lane, stride, numPairedLanes, numFrames, sumsOfSquares + lane, output ? output + lane : nullptr);
+        lane += numPairedLanes;
+    }
+
+    processScalar(coefficients, states + lane, input + lane, stride, numLanes - lane, numFrames, sumsOfSquares + lane, output ? output + lane : nullptr);
+}
+
+KWeightingKernel::InstructionSet KWeightingKernel::getInstructionSet()
+{
+    static const InstructionSet instructionSet = detectInstructionSet();
+
+    return instructionSet;
+}
+
+void KWeightingKernel::processScalar(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    const Stage& shelf = coefficients.shelf;
+    const Stage& highPass = coefficients.highPass;
+
+    for(size_t lane = 0; lane < numLanes; ++lane)
+    {
+        //Keep the state in registers for the whole run
+        LaneState state = states[lane];
+        double sumSquares = 0.0;
+
+        for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+        {
+            const double sample = input[frameIndex * stride + lane];
+
+            const double shelfToSave = sample - state.shelfPrev * shelf.a1 - state.shelfLast * shelf.a2;
+            const double shelfOutput = shelfToSave * shelf.b0 + state.shelfPrev * shelf.b1 + state.shelfLast * shelf.b2;
+            state.shelfLast = state.shelfPrev;
+            state.shelfPrev = shelfToSave;
+
+            const double highPassToSave = shelfOutput - state.highPassPrev * highPass.a1 - state.highPassLast * highPass.a2;
+            const double highPassOutput = highPassToSave * highPass.b0 + state.highPassPrev * highPass.b1 + state.highPassLast * highPass.b2;
+            state.highPassLast = state.highPassPrev;
+            state.highPassPrev = highPassToSave;
+
+            sumSquares += highPassOutput * highPassOutput;
+
+            if(output)
+            {
+                output[frameIndex * stride + lane] = static_cast<float>(highPassOutput);
+            }
+        }
+
+        states[lane] = state;
+        sumsOfSquares[lane] += sumSquares;
+    }
+}
+
+#if defined(LUFS_KWEIGHTING_X86_64)
+
+void KWeightingKernel::processSSE2(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    const Stage& shelf = coefficients.shelf;
+    const Stage& highPass = coefficients.highPass;
+
+    const __m128d shelfA1 = _mm_set1_pd(shelf.a1), shelfA2 = _mm_set1_pd(shelf.a2);
+    const __m128d shelfB0 = _mm_set1_pd(shelf.b0), shelfB1 = _mm_set1_pd(shelf.b1), shelfB2 = _mm_set1_pd(shelf.b2);
+    const __m128d highPassA1 = _mm_set1_pd(highPass.a1), highPassA2 = _mm_set1_pd(highPass.a2);
+    const __m128d highPassB0 = _mm_set1_pd(highPass.b0), highPassB1 = _mm_set1_pd(highPass.b1), highPassB2 = _mm_set1_pd(highPass.b2);
+
+    for(size_t lane = 0; lane + 2 <= numLanes; lane += 2)
+    {
+        __m128d shelfPrev = _mm_setr_pd(states[lane].shelfPrev, states[lane + 1].shelfPrev);
+        __m128d shelfLast = _mm_setr_pd(states[lane].shelfLast, states[lane + 1].shelfLast);
+        __m128d highPassPrev = _mm_setr_pd(states[lane].highPassPrev, states[lane + 1].highPassPrev);
+        __m128d highPassLast = _mm_setr_pd(states[lane].highPassLast, states[lane + 1].highPassLast);
+        __m128d sumSquares = _mm_setzero_pd();
+
+        for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+        {
+            const size_t readPos = frameIndex * stride + lane;
+            const __m128d sample = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + readPos))));
+
+            //Same operations in the same order as the scalar kernel so the results are identical
+            const __m128d shelfToSave = _mm_sub_pd(_mm_sub_pd(sample, _mm_mul_pd(shelfPrev, shelfA1)), _mm_mul_pd(shelfLast, shelfA2));
+            const __m128d shelfOutput = _mm_add_pd(_mm_add_pd(_mm_mul_pd(shelfToSave, shelfB0), _mm_mul_pd(shelfPrev, shelfB1)), _mm_mul_pd(shelfLast, shelfB2));
+            shelfLast = shelfPrev;
+            shelfPrev = shelfToSave;
+
+            const __m128d highPassToSave = _mm_sub_pd(_mm_sub_pd(shelfOutput, _mm_mul_pd(highPassPrev, highPassA1)), _mm_mul_pd(highPassLast, highPassA2));
+            const __m128d highPassOutput = _mm_add_pd(_mm_add_pd(_mm_mul_pd(highPassToSave, highPassB0), _mm_mul_pd(highPassPrev, highPassB1)), _mm_mul_pd(highPassLast, highPassB2));
+            highPassLast = highPassPrev;
+            highPassPrev = highPassToSave;
+
+            sumSquares = _mm_add_pd(sumSquares, _mm_mul_pd(highPassOutput, highPassOutput));
+
+            if(output)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(output + readPos), _mm_castps_si128(_mm_cvtpd_ps(highPassOutput)));
+            }
+        }
+
+        double shelfPrevs[2], shelfLasts[2], highPassPrevs[2], highPassLasts[2], sums[2];
+        _mm_storeu_pd(shelfPrevs, shelfPrev);
+        _mm_storeu_pd(shelfLasts, shelfLast);
+        _mm_storeu_pd(highPassPrevs, highPassPrev);
+        _mm_storeu_pd(highPassLasts, highPassLast);
+        _mm_storeu_pd(sums, sumSquares);
+
+        for(size_t pairIndex = 0; pairIndex < 2; ++pairIndex)
+        {
+            states[lane + pairIndex] = LaneState{shelfPrevs[pairIndex], shelfLasts[pairIndex], highPassPrevs[pairIndex], highPassLasts[pairIndex]};
+            sumsOfSquares[lane + pairIndex] += sums[pairIndex];
+        }
+    }
+}
+
+KWeightingKernel::InstructionSet KWeightingKernel::detectInstructionSet()
+{
+    //SSE2 is part of x86-64 so only AVX2 needs checking
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+
+    if(info[0] < 7)
+    {
+        return InstructionSet::SSE2;
+    }
+
+    //The OS must also save the upper halves of the registers
+    __cpuid(info, 1);
+    const bool osSavesAVXState = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(info, 7, 0);
+    const bool hasAVX2 = info[1] & (1 << 5);
+
+    return osSavesAVXState && hasAVX2 ? InstructionSet::AVX2 : InstructionSet::SSE2;
+#else
+    return __builtin_cpu_supports("avx2") ? InstructionSet::AVX2 : InstructionSet::SSE2;
+#endif
+}
+
+#else
+
+void KWeightingKernel::processSSE2(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    processScalar(coefficients, states, input, stride, numLanes, numFrames, sumsOfSquares, output);
+}
+
+KWeightingKernel::InstructionSet KWeightingKernel::detectInstructionSet()
+{
+    return InstructionSet::Scalar;
+}
+
+#endif
+
+}
@@ -0,0 +1,125 @@
+//This file is built with AVX2 enabled, it must only be called once the CPU is known to support it
+//FMA is left disabled so the results match the other kernels exactly
+
+#include "KWeightingKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+namespace LUFS
+{
+
+namespace
+{
+
+struct AVX2Coefficients
+{
+    __m256d shelfA1, shelfA2, shelfB0, shelfB1, shelfB2;
+    __m256d highPassA1, highPassA2, highPassB0, highPassB1, highPassB2;
+};
+
+//Runs numRegisters groups of 4 lanes together, their recursions are independent so they hide each others latency
+template<size_t numRegisters>
+void processLaneGroup(const AVX2Coefficients& c, KWeightingKernel::LaneState* states, const float* input, size_t stride, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    constexpr size_t lanesPerRegister = 4;
+
+    __m256d shelfPrev[numRegisters], shelfLast[numRegisters], highPassPrev[numRegisters], highPassLast[numRegisters], sumSquares[numRegisters];
+
+    for(size_t r = 0; r < numRegisters; ++r)
+    {
+        const KWeightingKernel::LaneState* s = states + r * lanesPerRegister;
+
+        shelfPrev[r] = _mm256_setr_pd(s[0].shelfPrev, s[1].shelfPrev, s[2].shelfPrev, s[3].shelfPrev);
+        shelfLast[r] = _mm256_setr_pd(s[0].shelfLast, s[1].shelfLast, s[2].shelfLast, s[3].shelfLast);
+        highPassPrev[r] = _mm256_setr_pd(s[0].highPassPrev, s[1].highPassPrev, s[2].highPassPrev, s[3].highPassPrev);
+        highPassLast[r] = _mm256_setr_pd(s[0].highPassLast, s[1].highPassLast, s[2].highPassLast, s[3].highPassLast);
+        sumSquares[r] = _mm256_setzero_pd();
+    }
+
+    for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+    {
+        for(size_t r = 0; r < numRegisters; ++r)
+        {
+            const size_t readPos = frameIndex * stride + r * lanesPerRegister;
+            const __m256d sample = _mm256_cvtps_pd(_mm_loadu_ps(input + readPos));
+
+            const __m256d shelfToSave = _mm256_sub_pd(_mm256_sub_pd(sample, _mm256_mul_pd(shelfPrev[r], c.shelfA1)), _mm256_mul_pd(shelfLast[r], c.shelfA2));
+            const __m256d shelfOutput = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(shelfToSave, c.shelfB0), _mm256_mul_pd(shelfPrev[r], c.shelfB1)), _mm256_mul_pd(shelfLast[r], c.shelfB2));
+            shelfLast[r] = shelfPrev[r];
+            shelfPrev[r] = shelfToSave;
+
+            const __m256d highPassToSave = _mm256_sub_pd(_mm256_sub_pd(shelfOutput, _mm256_mul_pd(highPassPrev[r], c.highPassA1)), _mm256_mul_pd(highPassLast[r], c.highPassA2));
+            const __m256d highPassOutput = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(highPassToSave, c.highPassB0), _mm256_mul_pd(highPassPrev[r], c.highPassB1)), _mm256_mul_pd(highPassLast[r], c.highPassB2));
+            highPassLast[r] = highPassPrev[r];
+            highPassPrev[r] = highPassToSave;
+
+            sumSquares[r] = _mm256_add_pd(sumSquares[r], _mm256_mul_pd(highPassOutput, highPassOutput));
+
+            if(output)
+            {
+                _mm_storeu_ps(output + readPos, _mm256_cvtpd_ps(highPassOutput));
+            }
+        }
+    }
+
+    for(size_t r = 0; r < numRegisters; ++r)
+    {
+        double shelfPrevs[4], shelfLasts[4], highPassPrevs[4], highPassLasts[4], sums[4];
+        _mm256_storeu_pd(shelfPrevs, shelfPrev[r]);
+        _mm256_storeu_pd(shelfLasts, shelfLast[r]);
+        _mm256_storeu_pd(highPassPrevs, highPassPrev[r]);
+        _mm256_storeu_pd(highPassLasts, highPassLast[r]);
+        _mm256_storeu_pd(sums, sumSquares[r]);
+
+        for(size_t laneIndex = 0; laneIndex < lanesPerRegister; ++laneIndex)
+        {
+            const size_t lane = r * lanesPerRegister + laneIndex;
+            states[lane] = KWeightingKernel::LaneState{shelfPrevs[laneIndex], shelfLasts[laneIndex], highPassPrevs[laneIndex], highPassLasts[laneIndex]};
+            sumsOfSquares[lane] += sums[laneIndex];
+        }
+    }
+}
+
+}
+
+size_t KWeightingKernel::processAVX2(const Coefficients& coefficients, LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, double* sumsOfSquares, float* output)
+{
+    const AVX2Coefficients c{
+        _mm256_set1_pd(coefficients.shelf.a1), _mm256_set1_pd(coefficients.shelf.a2),
+        _mm256_set1_pd(coefficients.shelf.b0), _mm256_set1_pd(coefficients.shelf.b1), _mm256_set1_pd(coefficients.shelf.b2),
+        _mm256_set1_pd(coefficients.highPass.a1), _mm256_set1_pd(coefficients.highPass.a2),
+        _mm256_set1_pd(coefficients.highPass.b0), _mm256_set1_pd(coefficients.highPass.b1), _mm256_set1_pd(coefficients.highPass.b2)
+    };
+
+    size_t lane = 0;
+
+    for(; lane + 8 <= numLanes; lane += 8)
+    {
+        processLaneGroup<2>(c, states + lane, input + lane, stride, numFrames, sumsOfSquares + lane, output ? output + lane : nullptr);
+    }
+
+    for(; lane + 4 <= numLanes; lane += 4)
+    {
+        processLaneGroup<1>(c, states + lane, input + lane, stride, numFrames, sumsOfSquares + lane, output ? output + lane : nullptr);
+    }
+
+    return lane;
+}
+
+}
+
+#else
+
+namespace LUFS
+{
+
+size_t KWeightingKernel::processAVX2(const Coefficients&, LaneState*, const float*, size_t, size_t, size_t, double*, float*)
+{
+    return 0;
+}
+
+}
+
+#endif
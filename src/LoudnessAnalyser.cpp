@@ -0,0 +1,107 @@
+#include "LoudnessAnalyser.h"
+
+#include "LoudnessRangeMeter.h"
+
+namespace LUFS
+{
+
+LoudnessAnalyser::LoudnessAnalyser(double sampleRate, const std::vector<Channel>& channels, float minLevel, std::pmr::memory_resource* memoryResource)  : min{minLevel}, subBlockFilter{sampleRate, channels, memoryResource}, subBlocks{numShortTermSubBlocks, memoryResource}, summary{Summary{}}, integratedHistogram{memoryResource}, shortTermHistogram{memoryResource}
+{
+
+}
+
+LoudnessAnalyser::LoudnessAnalyser(const std::vector<Channel>& channels, float minLevel, std::pmr::memory_resource* memoryResource)  : LoudnessAnalyser(defaultSampleRate, channels, minLevel, memoryResource)
+{
+
+}
+
+LoudnessAnalyser::~LoudnessAnalyser()
+{
+
+}
+
+void LoudnessAnalyser::process(std::span<const float* const> audio, int numSamplesPerChannel)
+{
+    assert(numSamplesPerChannel >= 0);
+
+    subBlockFilter.process(audio, static_cast<size_t>(numSamplesPerChannel), [this](double subBlockSum)
+    {
+        processSubBlock(subBlockSum);
+    });
+}
+
+void LoudnessAnalyser::process(std::span<const float> audio)
+{
+    subBlockFilter.process(audio, [this](double subBlockSum)
+    {
+        processSubBlock(subBlockSum);
+    });
+}
+
+void LoudnessAnalyser::reset()
+{
+    subBlockFilter.reset();
+    subBlocks.reset();
+
+    summary.publish(Summary{});
+    integratedHistogram.clear();
+    shortTermHistogram.clear();
+}
+
+float LoudnessAnalyser::getMomentaryLoudness() const
+{
+    return convertToLoudness(summary.read().momentaryMeanSquares);
+}
+
+float LoudnessAnalyser::getShortTermLoudness() const
+{
+    return convertToLoudness(summary.read().shortTermMeanSquares);
+}
+
+float LoudnessAnalyser::getIntegratedLoudness() const
+{
+    return integratedHistogram.calculateGatedLoudness(integratedGateRelativeThreshold).value_or(min);
+}
+
+float LoudnessAnalyser::getLoudnessRange() const
+{
+    return LoudnessRangeMeter::calculateLoudnessRange(shortTermHistogram);
+}
+
+void LoudnessAnalyser::processSubBlock(double subBlockSum)
+{
+    subBlocks.push(subBlockSum);
+
+    const size_t subBlockLengthSamples = subBlockFilter.getSubBlockLengthSamples();
+
+    const double momentaryMeanSquares = subBlocks.getSumOfLatest(numMomentarySubBlocks) / (numMomentarySubBlocks * subBlockLengthSamples);
+    const double shortTermMeanSquares = subBlocks.getSum() / (numShortTermSubBlocks * subBlockLengthSamples);
+
+    summary.publish(Summary{momentaryMeanSquares, shortTermMeanSquares});
+
+    //Each sub block completes a 400ms gating block with 75% overlap once there is enough data, likewise for each 3s short term block
+    const bool gatingBlockComplete = subBlocks.getNumPushed() >= numMomentarySubBlocks;
+    const bool shortTermBlockComplete = subBlocks.isFull();
+
+    if(gatingBlockComplete)
+    {
+        integratedHistogram.addBlock(momentaryMeanSquares);
+    }
+
+    if(shortTermBlockComplete)
+    {
+        shortTermHistogram.addBlock(shortTermMeanSquares);
+    }
+}
+
+float LoudnessAnalyser::convertToLoudness(double meanSquares) const
+{
+    if(meanSquares == 0.0)
+    {
+        return min;
+    }
+
+    return -0.691f + 10.0f * std::log10(meanSquares);
+}
+
+}
@@ -0,0 +1,246 @@
+#include "LoudnessHistogram.h"
+
+namespace LUFS
+{
+
+LoudnessHistogram::LoudnessHistogram(std::pmr::memory_resource* memoryResource)  : ownedNodes(numNodes, memoryResource), nodes{ownedNodes}
+{
+    assert(std::atomic<double>::is_always_lock_free);
+}
+
+LoudnessHistogram::LoudnessHistogram(std::span<Node> externalNodes)  : nodes{externalNodes}
+{
+    assert(std::atomic<double>::is_always_lock_free);
+    assert(nodes.size() == numNodes);
+}
+
+LoudnessHistogram::LoudnessHistogram(LoudnessHistogram&& other) noexcept  : ownedNodes{std::move(other.ownedNodes)}, nodes{std::exchange(other.nodes, {})}
+{
+
+}
+
+bool LoudnessHistogram::addBlock(double weightedMeanSquares)
+{
+    const double loudness = convertToLoudness(weightedMeanSquares);
+
+    if(!(loudness > lowestValue && loudness < highestValue))
+    {
+        return false;
+    }
+
+    nodesLock.beginWrite();
+
+    //Only this thread writes so the nodes don't need atomic read-modify-writes
+    for(size_t nodeIndex = getBinIndexForLoudness(loudness) + 1; nodeIndex <= numBins; nodeIndex += nodeIndex & (~nodeIndex + 1))
+    {
+        Node& node = nodes[nodeIndex];
+
+        node.meanSquares.store(node.meanSquares.load(std::memory_order_relaxed) + weightedMeanSquares, std::memory_order_relaxed);
+        node.numBlocks.store(node.numBlocks.load(std::memory_order_relaxed) + 1.0, std::memory_order_relaxed);
+    }
+
+    nodesLock.endWrite();
+
+    return true;
+}
+
+void LoudnessHistogram::clear()
+{
+    nodesLock.beginWrite();
+
+    std::for_each(nodes.begin(), nodes.end(), [](Node& node)
+    {
+        node.meanSquares.store(0.0, std::memory_order_relaxed);
+        node.numBlocks.store(0.0, std::memory_order_relaxed);
+    });
+
+    nodesLock.endWrite();
+}
+
+LoudnessHistogramState LoudnessHistogram::getState() const
+{
+    std::vector<Bin> bins = nodesLock.read([this]()
+    {
+        std::vector<Bin> nodeValues(nodes.size());
+
+        std::transform(nodes.begin(), nodes.end(), nodeValues.begin(), [](const Node& node)
+        {
+            return Bin{node.meanSquares.load(std::memory_order_relaxed), node.numBlocks.load(std::memory_order_relaxed)};
+        });
+
+        return nodeValues;
+    });
+
+    //Undo the Fenwick tree in place, each node only needs its direct children taking away so walk backwards
+    for(size_t nodeIndex = numBins; nodeIndex > 0; --nodeIndex)
+    {
+        const size_t parentIndex = nodeIndex + (nodeIndex & (~nodeIndex + 1));
+
+        if(parentIndex <= numBins)
+        {
+            bins[parentIndex].meanSquares -= bins[nodeIndex].meanSquares;
+            bins[parentIndex].numBlocks -= bins[nodeIndex].numBlocks;
+        }
+    }
+
+    LoudnessHistogramState state;
+
+    for(size_t binIndex = 0; binIndex < numBins; ++binIndex)
+    {
+        const Bin& bin = bins[binIndex + 1];
+
+        if(bin.numBlocks > 0.0)
+        {
+            state.bins.push_back({binIndex, std::max(bin.meanSquares, 0.0), bin.numBlocks});
+        }
+    }
+
+    return state;
+}
+
+std::optional<double> LoudnessHistogram::calculateMeanLoudness(const std::optional<float>& threshold) const
+{
+    return nodesLock.read([&]()
+    {
+        return calculateMeanLoudnessUnsynchronised(threshold);
+    });
+}
+
+std::optional<float> LoudnessHistogram::calculatePercentileLoudness(float percentile, const std::optional<float>& threshold) const
+{
+    return nodesLock.read([&]()
+    {
+        return calculatePercentileLoudnessUnsynchronised(percentile, threshold);
+    });
+}
+
+std::optional<double> LoudnessHistogram::calculateGatedLoudness(float relativeGate) const
+{
+    return nodesLock.read([&]() -> std::optional<double>
+    {
+        const std::optional<double> ungatedLoudness = calculateMeanLoudnessUnsynchronised(std::nullopt);
+
+        if(!ungatedLoudness)
+        {
+            return std::nullopt;
+        }
+
+        return calculateMeanLoudnessUnsynchronised(*ungatedLoudness + relativeGate);
+    });
+}
+
+std::optional<float> LoudnessHistogram::calculateGatedLoudnessRange(float relativeGate, float lowPercentile, float highPercentile) const
+{
+    return nodesLock.read([&]() -> std::optional<float>
+    {
+        const std::optional<double> ungatedLoudness = calculateMeanLoudnessUnsynchronised(std::nullopt);
+
+        if(!ungatedLoudness)
+        {
+            return std::nullopt;
+        }
+
+        const float threshold = *ungatedLoudness + relativeGate;
+
+        const std::optional<float> lowLoudness = calculatePercentileLoudnessUnsynchronised(lowPercentile, threshold);
+        const std::optional<float> highLoudness = calculatePercentileLoudnessUnsynchronised(highPercentile, threshold);
+
+        if(!lowLoudness || !highLoudness)
+        {
+            return std::nullopt;
+        }
+
+        return *highLoudness - *lowLoudness;
+    });
+}
+
+double LoudnessHistogram::convertToLoudness(double weightedMeanSquares)
+{
+    return -0.691 + 10.0 * std::log10(weightedMeanSquares);
+}
+
+std::optional<double> LoudnessHistogram::calculateMeanLoudnessUnsynchronised(const std::optional<float>& threshold) const
+{
+    const Bin total = sumBinsBelow(numBins);
+    const Bin belowThreshold = threshold ? sumBinsBelow(getBinIndexForLoudness(*threshold)) : Bin{};
+
+    //The bins below the threshold are always the quieter ones so this subtraction loses very little precision
+    const double meanSquares = total.meanSquares - belowThreshold.meanSquares;
+    const double numBlocks = total.numBlocks - belowThreshold.numBlocks;
+
+    if(numBlocks == 0.0 || meanSquares <= 0.0)
+    {
+        return std::nullopt;
+    }
+
+    return convertToLoudness(meanSquares / numBlocks);
+}
+
+std::optional<float> LoudnessHistogram::calculatePercentileLoudnessUnsynchronised(float percentile, const std::optional<float>& threshold) const
+{
+    const double numBlocksBelowThreshold = threshold ? sumBinsBelow(getBinIndexForLoudness(*threshold)).numBlocks : 0.0;
+    const double numBlocks = sumBinsBelow(numBins).numBlocks - numBlocksBelowThreshold;
+
+    if(numBlocks == 0.0)
+    {
+        return std::nullopt;
+    }
+
+    //Index the block would have if all the blocks were sorted by loudness, then offset by the blocks under the threshold
+    double remainingBlocks = numBlocksBelowThreshold + std::floor((numBlocks - 1.0) * std::clamp(percentile, 0.0f, 1.0f) + 0.5);
+
+    //Walk down the tree to find the last bin whose cumulative block count does not pass the index, the one after it holds the block
+    size_t nodeIndex = 0;
+    size_t step = 1;
+
+    while(step * 2 <= numBins)
+    {
+        step *= 2;
+    }
+
+    for(; step > 0; step /= 2)
+    {
+        const size_t nextNodeIndex = nodeIndex + step;
+
+        if(nextNodeIndex > numBins)
+        {
+            continue;
+        }
+
+        const double nodeNumBlocks = nodes[nextNodeIndex].numBlocks.load(std::memory_order_relaxed);
+
+        if(nodeNumBlocks <= remainingBlocks)
+        {
+            nodeIndex = nextNodeIndex;
+            remainingBlocks -= nodeNumBlocks;
+        }
+    }
+
+    return getLoudnessForBinIndex(std::min(nodeIndex, numBins - 1));
+}
+
+LoudnessHistogram::Bin LoudnessHistogram::sumBinsBelow(size_t binIndex) const
+{
+    Bin sum;
+
+    for(size_t nodeIndex = binIndex; nodeIndex > 0; nodeIndex -= nodeIndex & (~nodeIndex + 1))
+    {
+        sum.meanSquares += nodes[nodeIndex].meanSquares.load(std::memory_order_relaxed);
+        sum.numBlocks += nodes[nodeIndex].numBlocks.load(std::memory_order_relaxed);
+    }
+
+    return sum;
+}
+
+size_t LoudnessHistogram::getBinIndexForLoudness(float loudness)
+{
+    //Clamp before converting so thresholds below the range don't wrap around
+    return size_t(std::clamp(std::round(mappingSlope * (loudness - lowestValue)), 0.0f, float(numBins - 1)));
+}
+
+float LoudnessHistogram::getLoudnessForBinIndex(size_t binIndex) const
+{
+    return lowestValue + binIndex / mappingSlope;
+}
+
+}
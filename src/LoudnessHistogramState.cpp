@@ -0,0 +1,88 @@
+#include "LoudnessHistogramState.h"
+#include "LoudnessHistogram.h"
+
+namespace LUFS
+{
+
+LoudnessHistogramState::LoudnessHistogramState()
+{
+
+}
+
+void LoudnessHistogramState::merge(const LoudnessHistogramState& other)
+{
+    std::vector<Bin> mergedBins;
+    mergedBins.reserve(bins.size() + other.bins.size());
+
+    auto binIt = bins.begin();
+    auto otherBinIt = other.bins.begin();
+
+    while(binIt != bins.end() || otherBinIt != other.bins.end())
+    {
+        if(otherBinIt == other.bins.end() || (binIt != bins.end() && binIt->index < otherBinIt->index))
+        {
+            mergedBins.push_back(*binIt++);
+        }
+        else if(binIt == bins.end() || otherBinIt->index < binIt->index)
+        {
+            mergedBins.push_back(*otherBinIt++);
+        }
+        else
+        {
+            mergedBins.push_back({binIt->index, binIt->meanSquares + otherBinIt->meanSquares, binIt->numBlocks + otherBinIt->numBlocks});
+
+            ++binIt;
+            ++otherBinIt;
+        }
+    }
+
+    bins = std::move(mergedBins);
+}
+
+std::optional<double> LoudnessHistogramState::calculateGatedLoudness(float relativeGate) const
+{
+    const auto calculateMeanLoudness = [this](size_t firstBinIndex) -> std::optional<double>
+    {
+        double meanSquares = 0.0;
+        double numBlocks = 0.0;
+
+        std::for_each(bins.begin(), bins.end(), [&](const Bin& bin)
+        {
+            if(bin.index >= firstBinIndex)
+            {
+                meanSquares += bin.meanSquares;
+                numBlocks += bin.numBlocks;
+            }
+        });
+
+        if(numBlocks == 0.0 || meanSquares <= 0.0)
+        {
+            return std::nullopt;
+        }
+
+        return LoudnessHistogram::convertToLoudness(meanSquares / numBlocks);
+    };
+
+    const std::optional<double> ungatedLoudness = calculateMeanLoudness(0);
+
+    if(!ungatedLoudness)
+    {
+        return std::nullopt;
+    }
+
+    return calculateMeanLoudness(LoudnessHistogram::getBinIndexForLoudness(*ungatedLoudness + relativeGate));
+}
+
+uint64_t LoudnessHistogramState::getNumBlocks() const
+{
+    double numBlocks = 0.0;
+
+    std::for_each(bins.begin(), bins.end(), [&numBlocks](const Bin& bin)
+    {
+        numBlocks += bin.numBlocks;
+    });
+
+    return uint64_t(numBlocks);
+}
+
+}
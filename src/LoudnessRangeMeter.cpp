@@ -0,0 +1,68 @@
+#include "LoudnessRangeMeter.h"
+
+namespace LUFS
+{
+
+LoudnessRangeMeter::LoudnessRangeMeter(double sampleRate, const std::vector<Channel>& channels, std::pmr::memory_resource* memoryResource)  : subBlockFilter{sampleRate, channels, memoryResource}, subBlocks{numSubBlocksPerShortTermBlock, memoryResource}, shortTermHistogram{memoryResource}
+{
+
+}
+
+LoudnessRangeMeter::LoudnessRangeMeter(const std::vector<Channel>& channels, std::pmr::memory_resource* memoryResource)  : LoudnessRangeMeter(defaultSampleRate, channels, memoryResource)
+{
+
+}
+
+LoudnessRangeMeter::~LoudnessRangeMeter()
+{
+
+}
+
+void LoudnessRangeMeter::process(std::span<const float* const> audio, int numSamplesPerChannel)
+{
+    assert(numSamplesPerChannel >= 0);
+
+    subBlockFilter.process(audio, static_cast<size_t>(numSamplesPerChannel), [this](double subBlockSum)
+    {
+        processSubBlock(subBlockSum);
+    });
+}
+
+void LoudnessRangeMeter::process(std::span<const float> audio)
+{
+    subBlockFilter.process(audio, [this](double subBlockSum)
+    {
+        processSubBlock(subBlockSum);
+    });
+}
+
+void LoudnessRangeMeter::reset()
+{
+    subBlockFilter.reset();
+    subBlocks.reset();
+
+    shortTermHistogram.clear();
+}
+
+float LoudnessRangeMeter::getLoudnessRange() const
+{
+    return calculateLoudnessRange(shortTermHistogram);
+}
+
+float LoudnessRangeMeter::calculateLoudnessRange(const LoudnessHistogram& shortTermHistogram)
+{
+    return shortTermHistogram.calculateGatedLoudnessRange(gateRelativeThreshold, lowPercentile, highPercentile).value_or(0.0f);
+}
+
+void LoudnessRangeMeter::processSubBlock(double subBlockSum)
+{
+    subBlocks.push(subBlockSum);
+
+    //Every sub block completes an overlapping short term block once there have been enough of them
+    if(subBlocks.isFull())
+    {
+        shortTermHistogram.addBlock(subBlocks.getSum() / (numSubBlocksPerShortTermBlock * subBlockFilter.getSubBlockLengthSamples()));
+    }
+}
+
+}
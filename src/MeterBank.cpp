@@ -0,0 +1,360 @@
+#include "MeterBank.h"
+
+#include "ChannelProcessor.h"
+
+namespace LUFS
+{
+
+MeterBank::MeterBank(double sampleRate, const std::vector<Channel>& channels, size_t numStreams, Measurements measurements, size_t numThreads, float minLevel, std::pmr::memory_resource* memoryResource)  : numChannels{channels.size()}, numStreams{numStreams}, subBlockLengthSamples{SubBlockRing::getSubBlockLengthSamples(sampleRate)}, min{minLevel}, coefficients{ChannelProcessor::calculateKernelCoefficients(sampleRate)}, channelWeightings{memoryResource}, streams(numStreams, memoryResource), filterStates(numStreams * channels.size(), memoryResource), laneSumsOfSquares(numStreams * channels.size(), 0.0, memoryResource), integratedHistogramNodes(measurements == Measurements::MomentaryShortTermAndIntegrated ? numStreams * LoudnessHistogram::numNodes : 0, memoryResource), integratedHistograms(memoryResource), publishedStates(numStreams, memoryResource), threadPool{numThreads}
+{
+    integratedHistograms.reserve(integratedHistogramNodes.size() / LoudnessHistogram::numNodes);
+
+    for(size_t firstNode = 0; firstNode < integratedHistogramNodes.size(); firstNode += LoudnessHistogram::numNodes)
+    {
+        integratedHistograms.emplace_back(std::span(integratedHistogramNodes).subspan(firstNode, LoudnessHistogram::numNodes));
+    }
+
+    channelWeightings.reserve(channels.size());
+
+    std::transform(channels.begin(), channels.end(), std::back_insert_iterator(channelWeightings), [](const Channel& channel)
+    {
+        return channel.getWeighting();
+    });
+}
+
+MeterBank::MeterBank(const std::vector<Channel>& channels, size_t numStreams, Measurements measurements, size_t numThreads, float minLevel, std::pmr::memory_resource* memoryResource)  : MeterBank(defaultSampleRate, channels, numStreams, measurements, numThreads, minLevel, memoryResource)
+{
+
+}
+
+MeterBank::~MeterBank()
+{
+
+}
+
+void MeterBank::process(std::span<const std::span<const float* const>> streamAudio, int numSamplesPerChannel)
+{
+    assert(streamAudio.size() == numStreams);
+
+    threadPool.parallelFor(numStreams, [&](size_t streamIndex)
+    {
+        processStream(streamIndex, streamAudio[streamIndex], numSamplesPerChannel);
+    });
+
+    publishReadouts();
+}
+
+void MeterBank::process(std::span<const std::span<const float>> streamAudio)
+{
+    assert(streamAudio.size() == numStreams);
+
+    threadPool.parallelFor(numStreams, [&](size_t streamIndex)
+    {
+        const std::span<const float> audio = streamAudio[streamIndex];
+
+        assert(audio.size() % numChannels == 0);
+
+        processStream(streamIndex, audio.data(), numChannels, audio.size() / numChannels);
+    });
+
+    publishReadouts();
+}
+
+void MeterBank::processLockstep(std::span<const float> audio)
+{
+    const size_t numLanes = numStreams * numChannels;
+
+    if(numLanes == 0)
+    {
+        return;
+    }
+
+    assert(audio.size() % numLanes == 0);
+
+    //Each thread takes a contiguous group of streams, which is still a set of neighbouring lanes in every frame
+    const size_t maxNumGroups = std::max<size_t>(1, std::min(threadPool.getNumThreads(), numStreams));
+    const size_t numGroups = std::clamp(numLanes / minLockstepLanesPerThread, size_t(1), maxNumGroups);
+
+    if(numGroups == 1)
+    {
+        processLockstepStreams(0, numStreams, audio);
+    }
+    else
+    {
+        threadPool.parallelFor(numGroups, [&](size_t groupIndex)
+        {
+            processLockstepStreams(numStreams * groupIndex / numGroups, numStreams * (groupIndex + 1) / numGroups, audio);
+        });
+    }
+
+    publishReadouts();
+}
+
+void MeterBank::reset()
+{
+    for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+    {
+        resetStream(streamIndex);
+    }
+}
+
+void MeterBank::resetStream(size_t streamIndex)
+{
+    assert(streamIndex < numStreams);
+
+    streams[streamIndex] = StreamState{};
+
+    std::fill_n(filterStates.begin() + streamIndex * numChannels, numChannels, KWeightingKernel::LaneState{});
+
+    if(!integratedHistograms.empty())
+    {
+        integratedHistograms[streamIndex].clear();
+    }
+
+    readoutsLock.beginWrite();
+
+    PublishedState& published = publishedStates[streamIndex];
+    published.momentaryMeanSquares.store(0.0, std::memory_order_relaxed);
+    published.shortTermMeanSquares.store(0.0, std::memory_order_relaxed);
+
+    readoutsLock.endWrite();
+}
+
+void MeterBank::getReadouts(std::span<Readout> readouts) const
+{
+    assert(readouts.size() == numStreams);
+
+    //Every stream is read at once so the readouts are all from the same process call
+    readoutsLock.read([&]()
+    {
+        for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+        {
+            const PublishedState& published = publishedStates[streamIndex];
+
+            readouts[streamIndex].momentaryLoudness = convertToLoudness(published.momentaryMeanSquares.load(std::memory_order_relaxed));
+            readouts[streamIndex].shortTermLoudness = convertToLoudness(published.shortTermMeanSquares.load(std::memory_order_relaxed));
+        }
+
+        return true;
+    });
+
+    for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+    {
+        readouts[streamIndex].integratedLoudness = integratedHistograms.empty() ? min : integratedHistograms[streamIndex].calculateGatedLoudness(integratedGateRelativeThreshold).value_or(min);
+    }
+}
+
+size_t MeterBank::getNumStreams() const
+{
+    return numStreams;
+}
+
+double MeterBank::filterLanes(KWeightingKernel::LaneState* states, const float* input, size_t stride, size_t numLanes, size_t numFrames, const float* laneWeightings) const
+{
+    double weightedSumSquares = 0.0;
+
+    for(size_t firstLane = 0; firstLane < numLanes; firstLane += maxKernelLanes)
+    {
+        const size_t numGroupLanes = std::min(maxKernelLanes, numLanes - firstLane);
+
+        std::array<double, maxKernelLanes> sumsOfSquares{};
+
+        //The states are already contiguous so they are filtered in place
+        KWeightingKernel::process(coefficients, states + firstLane, input + firstLane, stride, numGroupLanes, numFrames, sumsOfSquares.data(), nullptr);
+
+        for(size_t lane = 0; lane < numGroupLanes; ++lane)
+        {
+            weightedSumSquares += laneWeightings[firstLane + lane] * sumsOfSquares[lane];
+        }
+    }
+
+    return weightedSumSquares;
+}
+
+void MeterBank::processStream(size_t streamIndex, std::span<const float* const> audio, size_t numSamplesPerChannel)
+{
+    assert(audio.size() == numChannels);
+
+    StreamState& stream = streams[streamIndex];
+    KWeightingKernel::LaneState* const states = filterStates.data() + streamIndex * numChannels;
+
+    size_t bufferReadPos = 0;
+
+    while(bufferReadPos < numSamplesPerChannel)
+    {
+        const size_t numSamplesToAdd = std::min(subBlockLengthSamples - stream.subBlockWritePos, numSamplesPerChannel - bufferReadPos);
+
+        for(size_t channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+        {
+            stream.currentSubBlockSum += filterLanes(states + channelIndex, audio[channelIndex] + bufferReadPos, 1, 1, numSamplesToAdd, channelWeightings.data() + channelIndex);
+        }
+
+        advanceSubBlockWritePos(streamIndex, numSamplesToAdd);
+        bufferReadPos += numSamplesToAdd;
+    }
+}
+
+void MeterBank::processStream(size_t streamIndex, const float* audio, size_t stride, size_t numFrames)
+{
+    StreamState& stream = streams[streamIndex];
+    KWeightingKernel::LaneState* const states = filterStates.data() + streamIndex * numChannels;
+
+    size_t bufferReadPos = 0;
+
+    while(bufferReadPos < numFrames)
+    {
+        const size_t numFramesToAdd = std::min(subBlockLengthSamples - stream.subBlockWritePos, numFrames - bufferReadPos);
+
+        //Every channel of the stream is filtered together
+        stream.currentSubBlockSum += filterLanes(states, audio + bufferReadPos * stride, stride, numChannels, numFramesToAdd, channelWeightings.data());
+
+        advanceSubBlockWritePos(streamIndex, numFramesToAdd);
+        bufferReadPos += numFramesToAdd;
+    }
+}
+
+void MeterBank::processLockstepStreams(size_t firstStream, size_t endStream, std::span<const float> audio)
+{
+    const size_t frameLength = numStreams * numChannels;
+    const size_t numFrames = audio.size() / frameLength;
+
+    const size_t firstLane = firstStream * numChannels;
+    const size_t numLanes = (endStream - firstStream) * numChannels;
+
+    //Streams given buffers of different lengths by process are at different points in their sub blocks, so can't share boundaries
+    const size_t firstSubBlockWritePos = streams[firstStream].subBlockWritePos;
+
+    const bool streamsAligned = std::all_of(streams.begin() + firstStream, streams.begin() + endStream, [firstSubBlockWritePos](const StreamState& stream)
+    {
+        return stream.subBlockWritePos == firstSubBlockWritePos;
+    });
+
+    if(!streamsAligned)
+    {
+        for(size_t streamIndex = firstStream; streamIndex < endStream; ++streamIndex)
+        {
+            processStream(streamIndex, audio.data() + streamIndex * numChannels, frameLength, numFrames);
+        }
+
+        return;
+    }
+
+    size_t bufferReadPos = 0;
+
+    while(bufferReadPos < numFrames)
+    {
+        //Every stream is at the same point in its sub block so one check covers them all
+        const size_t subBlockWritePos = streams[firstStream].subBlockWritePos;
+        const size_t numFramesToAdd = std::min(subBlockLengthSamples - subBlockWritePos, numFrames - bufferReadPos);
+        const bool subBlockComplete = subBlockWritePos + numFramesToAdd >= subBlockLengthSamples;
+
+        double* const sumsOfSquares = laneSumsOfSquares.data() + firstLane;
+        std::fill_n(sumsOfSquares, numLanes, 0.0);
+
+        KWeightingKernel::process(coefficients, filterStates.data() + firstLane, audio.data() + bufferReadPos * frameLength + firstLane, frameLength, numLanes, numFramesToAdd, sumsOfSquares, nullptr);
+
+        for(size_t streamIndex = firstStream; streamIndex < endStream; ++streamIndex)
+        {
+            StreamState& stream = streams[streamIndex];
+
+            const double* const streamSumsOfSquares = laneSumsOfSquares.data() + streamIndex * numChannels;
+
+            //Summed in the same order as filterLanes so lockstep streams measure exactly the same as streams processed on their own
+            double weightedSumSquares = 0.0;
+
+            for(size_t channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+            {
+                weightedSumSquares += channelWeightings[channelIndex] * streamSumsOfSquares[channelIndex];
+            }
+
+            stream.currentSubBlockSum += weightedSumSquares;
+
+            stream.subBlockWritePos += numFramesToAdd;
+
+            if(subBlockComplete)
+            {
+                completeSubBlock(streamIndex);
+            }
+        }
+
+        bufferReadPos += numFramesToAdd;
+    }
+}
+
+void MeterBank::advanceSubBlockWritePos(size_t streamIndex, size_t numSamples)
+{
+    StreamState& stream = streams[streamIndex];
+
+    stream.subBlockWritePos += numSamples;
+
+    if(stream.subBlockWritePos >= subBlockLengthSamples)
+    {
+        completeSubBlock(streamIndex);
+    }
+}
+
+void MeterBank::completeSubBlock(size_t streamIndex)
+{
+    StreamState& stream = streams[streamIndex];
+
+    stream.subBlockSums[stream.subBlockSumsWritePos] = stream.currentSubBlockSum;
+    stream.subBlockSumsWritePos = (stream.subBlockSumsWritePos + 1) % numShortTermSubBlocks;
+    ++stream.numSubBlocks;
+
+    stream.currentSubBlockSum = 0.0;
+    stream.subBlockWritePos = 0;
+
+    //The sums are summed again each time rather than kept running, so rounding errors can never build up
+    double momentarySum = 0.0;
+    double shortTermSum = 0.0;
+
+    for(size_t subBlockIndex = 0; subBlockIndex < numShortTermSubBlocks; ++subBlockIndex)
+    {
+        //Oldest first, so the last few are the momentary block
+        const double subBlockSum = stream.subBlockSums[(stream.subBlockSumsWritePos + subBlockIndex) % numShortTermSubBlocks];
+
+        shortTermSum += subBlockSum;
+
+        if(subBlockIndex >= numShortTermSubBlocks - numMomentarySubBlocks)
+        {
+            momentarySum += subBlockSum;
+        }
+    }
+
+    stream.momentaryMeanSquares = momentarySum / (numMomentarySubBlocks * subBlockLengthSamples);
+    stream.shortTermMeanSquares = shortTermSum / (numShortTermSubBlocks * subBlockLengthSamples);
+
+    //Each sub block completes a 400ms gating block with 75% overlap once there is enough data
+    if(!integratedHistograms.empty() && stream.numSubBlocks >= numMomentarySubBlocks)
+    {
+        integratedHistograms[streamIndex].addBlock(stream.momentaryMeanSquares);
+    }
+}
+
+void MeterBank::publishReadouts()
+{
+    readoutsLock.beginWrite();
+
+    for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+    {
+        const StreamState& stream = streams[streamIndex];
+        PublishedState& published = publishedStates[streamIndex];
+
+        published.momentaryMeanSquares.store(stream.momentaryMeanSquares, std::memory_order_relaxed);
+        published.shortTermMeanSquares.store(stream.shortTermMeanSquares, std::memory_order_relaxed);
+    }
+
+    readoutsLock.endWrite();
+}
+
+float MeterBank::convertToLoudness(double meanSquares) const
+{
+    if(meanSquares == 0.0)
+    {
+        return min;
+    }
+
+    return -0.691f + 10.0f * std::log10(meanSquares);
+}
+
+}
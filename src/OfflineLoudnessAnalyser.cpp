@@ -0,0 +1,129 @@
+#include "OfflineLoudnessAnalyser.h"
+#include "IntegratedLoudnessMeter.h"
+
+namespace LUFS
+{
+
+OfflineLoudnessAnalyser::OfflineLoudnessAnalyser(double sampleRate, const std::vector<Channel>& channels, size_t numThreads)  : sampleRate{sampleRate}, channels{channels}, subBlockLengthSamples{SubBlockRing::getSubBlockLengthSamples(sampleRate)}, threadPool{numThreads}
+{
+
+}
+
+OfflineLoudnessAnalyser::OfflineLoudnessAnalyser(const std::vector<Channel>& channels, size_t numThreads)  : OfflineLoudnessAnalyser(defaultSampleRate, channels, numThreads)
+{
+
+}
+
+OfflineLoudnessAnalyser::~OfflineLoudnessAnalyser()
+{
+
+}
+
+LoudnessHistogramState OfflineLoudnessAnalyser::analyse(std::span<const float* const> audio, size_t numSamplesPerChannel)
+{
+    assert(audio.size() == channels.size());
+
+    return analyseChunks(numSamplesPerChannel, [&](IntegratedLoudnessMeter& meter, size_t start, size_t numSamples)
+    {
+        std::vector<const float*> channelPointers;
+
+        std::transform(audio.begin(), audio.end(), std::back_insert_iterator(channelPointers), [start](const float* channelData)
+        {
+            return channelData + start;
+        });
+
+        meter.process(channelPointers, static_cast<int>(numSamples));
+    });
+}
+
+LoudnessHistogramState OfflineLoudnessAnalyser::analyse(std::span<const float> audio)
+{
+    assert(audio.size() % channels.size() == 0);
+
+    const size_t numChannels = channels.size();
+
+    return analyseChunks(audio.size() / numChannels, [&](IntegratedLoudnessMeter& meter, size_t start, size_t numSamples)
+    {
+        meter.process(audio.subspan(start * numChannels, numSamples * numChannels));
+    });
+}
+
+float OfflineLoudnessAnalyser::analyseLoudness(std::span<const float* const> audio, size_t numSamplesPerChannel, float minLevel)
+{
+    return IntegratedLoudnessMeter::calculateLoudness(analyse(audio, numSamplesPerChannel), minLevel);
+}
+
+float OfflineLoudnessAnalyser::analyseLoudness(std::span<const float> audio, float minLevel)
+{
+    return IntegratedLoudnessMeter::calculateLoudness(analyse(audio), minLevel);
+}
+
+std::vector<OfflineLoudnessAnalyser::Chunk> OfflineLoudnessAnalyser::calculateChunks(size_t numSamplesPerChannel) const
+{
+    const size_t numChunksWanted = threadPool.getNumThreads() * numChunksPerThread;
+
+    //Round up to whole sub blocks so every chunk apart from the last starts and ends on a gating block step
+    const size_t warmUpLengthSamples = numWarmUpSubBlocks * subBlockLengthSamples;
+
+    size_t chunkLength = std::max((numSamplesPerChannel + numChunksWanted - 1) / numChunksWanted, minChunkLengthSubBlocks * subBlockLengthSamples);
+    chunkLength = ((chunkLength + subBlockLengthSamples - 1) / subBlockLengthSamples) * subBlockLengthSamples;
+
+    std::vector<Chunk> chunks;
+
+    for(size_t start = 0; start < numSamplesPerChannel; start += chunkLength)
+    {
+        Chunk chunk;
+        chunk.warmUpStart = start - std::min(start, warmUpLengthSamples);
+        chunk.start = start;
+        chunk.end = std::min(start + chunkLength, numSamplesPerChannel);
+
+        chunks.push_back(chunk);
+    }
+
+    return chunks;
+}
+
+template<typename ProcessRange>
+LoudnessHistogramState OfflineLoudnessAnalyser::analyseChunks(size_t numSamplesPerChannel, ProcessRange&& processRange)
+{
+    const std::vector<Chunk> chunks = calculateChunks(numSamplesPerChannel);
+    std::vector<LoudnessHistogramState> chunkStates(chunks.size());
+
+    threadPool.parallelFor(chunks.size(), [&](size_t chunkIndex)
+    {
+        const Chunk& chunk = chunks[chunkIndex];
+        IntegratedLoudnessMeter meter{sampleRate, channels};
+
+        auto processPieces = [&](size_t start, size_t end)
+        {
+            const size_t maxProcessLengthSamples = maxProcessLengthSubBlocks * subBlockLengthSamples;
+
+            for(size_t pieceStart = start; pieceStart < end; pieceStart += maxProcessLengthSamples)
+            {
+                processRange(meter, pieceStart, std::min(maxProcessLengthSamples, end - pieceStart));
+            }
+        };
+
+        //Blocks that end within the warm up belong to the chunk before
+        if(chunk.warmUpStart < chunk.start)
+        {
+            processPieces(chunk.warmUpStart, chunk.start);
+            meter.resetIntegration();
+        }
+
+        processPieces(chunk.start, chunk.end);
+
+        chunkStates[chunkIndex] = meter.getState();
+    });
+
+    LoudnessHistogramState state;
+
+    std::for_each(chunkStates.begin(), chunkStates.end(), [&state](const LoudnessHistogramState& chunkState)
+    {
+        state.merge(chunkState);
+    });
+
+    return state;
+}
+
+}
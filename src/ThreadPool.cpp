@@ -0,0 +1,202 @@
+#include "ThreadPool.h"
+
+namespace LUFS
+{
+
+ThreadPool::ThreadPool(size_t numThreads)
+{
+    if(numThreads == 0)
+    {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    taskRanges = std::vector<TaskRange>(numThreads);
+
+    //Thread index 0 is the calling thread
+    for(size_t threadIndex = 1; threadIndex < numThreads; ++threadIndex)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this, threadIndex);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock<std::mutex> lock{stateLock};
+        stopping = true;
+    }
+
+    workAvailable.notify_all();
+
+    std::for_each(workers.begin(), workers.end(), [](std::thread& worker)
+    {
+        worker.join();
+    });
+}
+
+void ThreadPool::parallelFor(size_t numTasks, const std::function<void(size_t)>& task)
+{
+    if(numTasks == 0)
+    {
+        return;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock{stateLock};
+
+        currentTask = &task;
+        currentNumTasks = numTasks;
+        numTasksFinished = 0;
+        firstException = nullptr;
+
+        const size_t numThreads = taskRanges.size();
+
+        for(size_t threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+        {
+            TaskRange& range = taskRanges[threadIndex];
+            range.next.store(numTasks * threadIndex / numThreads, std::memory_order_relaxed);
+            range.end = numTasks * (threadIndex + 1) / numThreads;
+        }
+
+        ++generation;
+    }
+
+    workAvailable.notify_all();
+
+    runTasks(task, 0);
+
+    std::exception_ptr exception;
+
+    {
+        //Workers still running tasks from this batch must finish before the task goes out of scope
+        std::unique_lock<std::mutex> lock{stateLock};
+        workFinished.wait(lock, [this]()
+        {
+            return numTasksFinished == currentNumTasks && numActiveWorkers == 0;
+        });
+
+        currentTask = nullptr;
+        exception = firstException;
+    }
+
+    if(exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+size_t ThreadPool::getNumThreads() const
+{
+    return workers.size() + 1;
+}
+
+void ThreadPool::workerLoop(size_t threadIndex)
+{
+    uint64_t lastGeneration = 0;
+
+    while(true)
+    {
+        const std::function<void(size_t)>* task = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock{stateLock};
+            workAvailable.wait(lock, [&]()
+            {
+                return stopping || (generation != lastGeneration && currentTask);
+            });
+
+            if(stopping)
+            {
+                return;
+            }
+
+            lastGeneration = generation;
+            task = currentTask;
+
+            ++numActiveWorkers;
+        }
+
+        runTasks(*task, threadIndex);
+
+        {
+            std::scoped_lock<std::mutex> lock{stateLock};
+            --numActiveWorkers;
+        }
+
+        workFinished.notify_all();
+    }
+}
+
+void ThreadPool::runTasks(const std::function<void(size_t)>& task, size_t threadIndex)
+{
+    size_t numTasksRun = 0;
+    size_t taskIndex = 0;
+    std::exception_ptr exception;
+
+    while(claimTask(threadIndex, taskIndex))
+    {
+        try
+        {
+            task(taskIndex);
+        }
+        catch(...)
+        {
+            if(!exception)
+            {
+                exception = std::current_exception();
+            }
+        }
+
+        ++numTasksRun;
+    }
+
+    bool allTasksFinished = false;
+
+    {
+        //Each thread only takes the lock once per batch
+        std::scoped_lock<std::mutex> lock{stateLock};
+
+        if(exception && !firstException)
+        {
+            firstException = exception;
+        }
+
+        numTasksFinished += numTasksRun;
+        allTasksFinished = numTasksFinished == currentNumTasks;
+    }
+
+    if(allTasksFinished)
+    {
+        workFinished.notify_all();
+    }
+}
+
+bool ThreadPool::claimTask(size_t threadIndex, size_t& taskIndex)
+{
+    const size_t numThreads = taskRanges.size();
+
+    for(size_t rangeOffset = 0; rangeOffset < numThreads; ++rangeOffset)
+    {
+        TaskRange& range = taskRanges[(threadIndex + rangeOffset) % numThreads];
+
+        //Empty ranges are only read so their cache lines aren't taken from threads still working
+        if(range.next.load(std::memory_order_relaxed) >= range.end)
+        {
+            continue;
+        }
+
+        //Several threads can overshoot the end of a range at once, which is harmless as the index is checked
+        const size_t index = range.next.fetch_add(1, std::memory_order_relaxed);
+
+        if(index < range.end)
+        {
+            taskIndex = index;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
@@ -3,144 +3,178 @@
 namespace LUFS
 {
 
-TruePeakMeter::TruePeakMeter(double sampleRate, int numChannels, int maxBufferSize, float minLevel)  : expectedNumChannels{numChannels}, bufferSizeLimit{maxBufferSize}, sampleRateConversionRatio{targetSampleRate / sampleRate}, min{minLevel}
+TruePeakMeter::TruePeakMeter(double sampleRate, int numChannels, float minLevel, std::pmr::memory_resource* memoryResource)  : min{minLevel}, expectedNumChannels{numChannels}, oversampler{static_cast<size_t>(numChannels), calculateOversamplingFactor(sampleRate), memoryResource}, channelTruePeakGains(numChannels, memoryResource), channelSamplePeakGains(numChannels, memoryResource), interleavedBlockPeaks(numChannels, memoryResource)
 {
     assert(std::atomic<float>::is_always_lock_free);
+}
 
-    int error;
-    sampleRateConverter = src_new(SRC_SINC_FASTEST, numChannels, &error);
-
-    if(!sampleRateConverter || error != 0)
-    {
-        sampleRateConverter = nullptr;
-        throw(std::runtime_error("Failed to create sample rate converter"));
-    }
-
-    if(src_is_valid_ratio(sampleRateConversionRatio) == 0)
-    {
-        throw(std::runtime_error("Input sample rate is not supported"));
-    }
-
-    //Set buffers to the max size they can be
-    conversionInputBuffer.resize(expectedNumChannels * bufferSizeLimit);
-    conversionOutputBuffer.resize(conversionInputBuffer.size() * sampleRateConversionRatio);
+TruePeakMeter::TruePeakMeter(double sampleRate, int numChannels, int, float minLevel)  : TruePeakMeter(sampleRate, numChannels, minLevel)
+{
 
-    sampleRateConverterState.data_in = conversionInputBuffer.data();
-    sampleRateConverterState.data_out = conversionOutputBuffer.data();
-    sampleRateConverterState.src_ratio = sampleRateConversionRatio;
-    sampleRateConverterState.input_frames_used = 0;
-    sampleRateConverterState.output_frames_gen = 0;
-    sampleRateConverterState.end_of_input = 0;
 }
 
 TruePeakMeter::~TruePeakMeter()
 {
-    if(sampleRateConverter)
-    {
-        src_delete(sampleRateConverter);
-    }
+
 }
 
 void TruePeakMeter::process(std::span<const float* const> audio, int numSamplesPerChannel)
 {
-    assert(audio.size() == expectedNumChannels);
-    assert(numSamplesPerChannel <= bufferSizeLimit);
+    assert(audio.size() == static_cast<size_t>(expectedNumChannels));
 
-    std::unique_lock<SpinLock> lock{resetLock, std::try_to_lock};
+    applyPendingReset();
 
-    if(!lock)
+    for(int channelIndex = 0; channelIndex < expectedNumChannels; ++channelIndex)
     {
-        return;
+        publishPeaks(channelIndex, oversampler.process(channelIndex, audio[channelIndex], numSamplesPerChannel));
     }
+}
 
-    if(audio.size() == 0)
-    {
-        return;
-    }
+void TruePeakMeter::process(std::span<const float> audio)
+{
+    assert(audio.size() % expectedNumChannels == 0);
 
-    //Set conversion size
-    sampleRateConverterState.input_frames = numSamplesPerChannel;
-    sampleRateConverterState.output_frames = numSamplesPerChannel * sampleRateConversionRatio;
+    applyPendingReset();
+
+    oversampler.process(audio, interleavedBlockPeaks);
 
-    //Copy to interleaved input buffer
     for(int channelIndex = 0; channelIndex < expectedNumChannels; ++channelIndex)
     {
-        const float* const channelBuffer = audio[channelIndex];
-
-        for(int sampleIndex = 0; sampleIndex < numSamplesPerChannel; ++sampleIndex)
-        {
-            conversionInputBuffer[sampleIndex * expectedNumChannels + channelIndex] = channelBuffer[sampleIndex] * inputGain;
-        }
+        publishPeaks(channelIndex, interleavedBlockPeaks[channelIndex]);
     }
+}
 
-    process();
+void TruePeakMeter::reset()
+{
+    numResetsRequested.fetch_add(1);
 }
 
-void TruePeakMeter::process(std::span<const float> audio)
+float TruePeakMeter::getTruePeak() const
 {
-    assert(audio.size() % expectedNumChannels == 0);
+    return convertToDecibels(isResetPending() ? 0.0f : findLargest(channelTruePeakGains));
+}
+
+float TruePeakMeter::getTruePeak(int channelIndex) const
+{
+    assert(channelIndex >= 0 && channelIndex < expectedNumChannels);
+
+    return convertToDecibels(isResetPending() ? 0.0f : channelTruePeakGains[channelIndex].load());
+}
+
+float TruePeakMeter::getSamplePeak() const
+{
+    return convertToDecibels(isResetPending() ? 0.0f : findLargest(channelSamplePeakGains));
+}
 
-    const size_t bufferSize = audio.size() / expectedNumChannels;
+float TruePeakMeter::getSamplePeak(int channelIndex) const
+{
+    assert(channelIndex >= 0 && channelIndex < expectedNumChannels);
+
+    return convertToDecibels(isResetPending() ? 0.0f : channelSamplePeakGains[channelIndex].load());
+}
 
-    assert(bufferSize <= bufferSizeLimit);
+int TruePeakMeter::getOversamplingFactor() const
+{
+    return static_cast<int>(oversampler.getOversamplingFactor());
+}
 
-    std::unique_lock<SpinLock> lock{resetLock, std::try_to_lock};
+void TruePeakMeter::publishPeaks(int channelIndex, const TruePeakOversampler::Peaks& peaks)
+{
+    //Only this thread writes the peaks, reset just asks for them to be cleared, so they don't need a compare exchange
+    //The peaks of the whole block have already been reduced, so this is the only store each one gets per call
+    std::atomic<float>& truePeakGain = channelTruePeakGains[channelIndex];
+    const float truePeak = truePeakGain.load(std::memory_order_relaxed);
 
-    if(!lock)
+    if(peaks.truePeak > truePeak)
     {
-        return;
+        truePeakGain.store(peaks.truePeak, std::memory_order_release);
     }
 
-    //Set conversion size
-    sampleRateConverterState.input_frames = static_cast<int32_t>(bufferSize);
-    sampleRateConverterState.output_frames = static_cast<int32_t>(bufferSize) * sampleRateConversionRatio;
+    std::atomic<float>& samplePeakGain = channelSamplePeakGains[channelIndex];
+    const float samplePeak = samplePeakGain.load(std::memory_order_relaxed);
 
-    std::transform(audio.begin(), audio.end(), conversionInputBuffer.begin(), [this](float sample)
+    if(peaks.samplePeak > samplePeak)
     {
-        return sample * inputGain;
-    });
+        samplePeakGain.store(peaks.samplePeak, std::memory_order_release);
+    }
+}
 
-    process();
+void TruePeakMeter::applyPendingReset()
+{
+    const uint64_t numRequested = numResetsRequested.load();
+
+    if(numRequested == numResetsApplied.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    oversampler.reset();
+
+    //Anything published by a process call that was running when reset was called is cleared as well
+    clearPeaks();
+
+    //Readers see the cleared peaks from here, until now they have read as cleared without looking at them
+    numResetsApplied.store(numRequested, std::memory_order_release);
 }
 
-void TruePeakMeter::reset()
+bool TruePeakMeter::isResetPending() const
 {
-    std::scoped_lock<SpinLock> lock{resetLock};
+    //A later reset may be applied between the two loads, the peaks have just been cleared then so reading them as cleared is still right
+    const uint64_t numRequested = numResetsRequested.load();
 
-    src_reset(sampleRateConverter);
+    return numRequested != numResetsApplied.load(std::memory_order_acquire);
+}
 
-    currentTruePeakGain.store(0.0f);
+void TruePeakMeter::clearPeaks()
+{
+    for(int channelIndex = 0; channelIndex < expectedNumChannels; ++channelIndex)
+    {
+        channelTruePeakGains[channelIndex].store(0.0f, std::memory_order_relaxed);
+        channelSamplePeakGains[channelIndex].store(0.0f, std::memory_order_relaxed);
+    }
 }
 
-float TruePeakMeter::getTruePeak() const
+float TruePeakMeter::findLargest(const std::pmr::vector<std::atomic<float>>& channelPeaks)
 {
-    float localTruePeak = currentTruePeakGain.load();
+    float largest = 0.0f;
 
-    if(localTruePeak == 0.0f)
+    std::for_each(channelPeaks.begin(), channelPeaks.end(), [&largest](const std::atomic<float>& channelPeak)
+    {
+        largest = std::max(largest, channelPeak.load());
+    });
+
+    return largest;
+}
+
+float TruePeakMeter::convertToDecibels(float gain) const
+{
+    if(gain == 0.0f)
     {
         return min;
     }
 
-    return 20.0f * std::log10(localTruePeak);
+    return 20.0f * std::log10(gain);
 }
 
-void TruePeakMeter::process()
+size_t TruePeakMeter::calculateOversamplingFactor(double sampleRate)
 {
-    if(!sampleRateConverter)
+    if(!(sampleRate > 0.0))
     {
-        return;
+        throw(std::runtime_error("Input sample rate is not supported"));
     }
 
-    if(src_process(sampleRateConverter, &sampleRateConverterState) != 0)
+    //Enough to bring every rate to at least 176.4kHz
+    if(sampleRate < 88200.0)
     {
-        //SOME SORT OF ERROR
-        return;
+        return 4;
     }
 
-    std::for_each(conversionOutputBuffer.begin(), conversionOutputBuffer.end(), [this](float convertedSample)
+    if(sampleRate < 176400.0)
     {
-        currentTruePeakGain.store(std::max(std::abs(convertedSample) * outputGain, currentTruePeakGain.load()));
-    });
+        return 2;
+    }
+
+    return 1;
 }
 
-}
\ No newline at end of file
+}
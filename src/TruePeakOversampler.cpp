@@ -0,0 +1,280 @@
+#include "TruePeakOversampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LUFS_OVERSAMPLER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace LUFS
+{
+
+//Table 1 of ITU-R BS.1770 Annex 2, with each phase stored in reverse
+const std::array<std::array<float, TruePeakOversampler::tapsPerPhase>, TruePeakOversampler::numPhases> TruePeakOversampler::reversedPhases{{
+    {-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f, 0.9721679687500f, 0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f},
+    {-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f, 0.7797851562500f, 0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f},
+    {-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f, 0.4650878906250f, 0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f},
+    {0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f, 0.1373291015625f, 0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f}
+}};
+
+TruePeakOversampler::TruePeakOversampler(size_t numChannels, size_t oversamplingFactor, std::pmr::memory_resource* memoryResource)  : numInputChannels{numChannels}, factor{oversamplingFactor}, channelHistories(numChannels * historyLength, 0.0f, memoryResource), stitchBuffer{}, chunkLengthFrames{std::max<size_t>(chunkLengthSamples / numChannels, 1)}, deinterleaveBuffer(chunkLengthFrames * numChannels, 0.0f, memoryResource)
+{
+    if(factor != 1 && factor != 2 && factor != numPhases)
+    {
+        throw(std::runtime_error("Oversampling factor must be 1, 2 or 4"));
+    }
+
+    //Every other phase is still evenly spaced, half a sample apart
+    for(size_t phaseIndex = 0; phaseIndex < factor; ++phaseIndex)
+    {
+        activePhases[phaseIndex] = reversedPhases[phaseIndex * (numPhases / factor)];
+    }
+}
+
+TruePeakOversampler::Peaks TruePeakOversampler::process(size_t channelIndex, const float* samples, size_t numSamples)
+{
+    assert(channelIndex < numInputChannels);
+
+    if(factor == 1)
+    {
+        const float samplePeak = findSamplePeak(samples, numSamples);
+
+        return Peaks{samplePeak, samplePeak};
+    }
+
+    float* const history = channelHistories.data() + channelIndex * historyLength;
+
+    //The first outputs also need the end of the previous block, so the first samples are copied after the history
+    const size_t numStitchedSamples = std::min(historyLength, numSamples);
+
+    std::copy(history, history + historyLength, stitchBuffer.begin());
+    std::copy(samples, samples + numStitchedSamples, stitchBuffer.begin() + historyLength);
+
+    Peaks peaks = processContiguous(stitchBuffer.data(), numStitchedSamples);
+
+    //Every later output only needs samples from this block, so they are read in place
+    if(numSamples > historyLength)
+    {
+        const Peaks directPeaks = processContiguous(samples, numSamples - historyLength);
+
+        peaks.truePeak = std::max(peaks.truePeak, directPeaks.truePeak);
+        peaks.samplePeak = std::max(peaks.samplePeak, directPeaks.samplePeak);
+
+        std::copy(samples + numSamples - historyLength, samples + numSamples, history);
+    }
+    else
+    {
+        std::copy(stitchBuffer.begin() + numStitchedSamples, stitchBuffer.begin() + numStitchedSamples + historyLength, history);
+    }
+
+    return peaks;
+}
+
+void TruePeakOversampler::process(std::span<const float> audio, std::span<Peaks> channelPeaks)
+{
+    assert(channelPeaks.size() == numInputChannels);
+    assert(audio.size() % numInputChannels == 0);
+
+    //A single channel is already planar
+    if(numInputChannels == 1)
+    {
+        channelPeaks[0] = process(0, audio.data(), audio.size());
+
+        return;
+    }
+
+    std::fill(channelPeaks.begin(), channelPeaks.end(), Peaks{});
+
+    const size_t numFrames = audio.size() / numInputChannels;
+
+    for(size_t chunkStart = 0; chunkStart < numFrames; chunkStart += chunkLengthFrames)
+    {
+        const size_t numChunkFrames = std::min(chunkLengthFrames, numFrames - chunkStart);
+
+        deinterleave(audio.data() + chunkStart * numInputChannels, numInputChannels, numChunkFrames, deinterleaveBuffer.data(), chunkLengthFrames);
+
+        for(size_t channelIndex = 0; channelIndex < numInputChannels; ++channelIndex)
+        {
+            const Peaks chunkPeaks = process(channelIndex, deinterleaveBuffer.data() + channelIndex * chunkLengthFrames, numChunkFrames);
+
+            Peaks& peaks = channelPeaks[channelIndex];
+            peaks.truePeak = std::max(peaks.truePeak, chunkPeaks.truePeak);
+            peaks.samplePeak = std::max(peaks.samplePeak, chunkPeaks.samplePeak);
+        }
+    }
+}
+
+void TruePeakOversampler::reset()
+{
+    std::fill(channelHistories.begin(), channelHistories.end(), 0.0f);
+}
+
+size_t TruePeakOversampler::getOversamplingFactor() const
+{
+    return factor;
+}
+
+TruePeakOversampler::Peaks TruePeakOversampler::processContiguous(const float* input, size_t numOutputs) const
+{
+    return factor == numPhases ? processContiguous<numPhases>(input, numOutputs) : processContiguous<2>(input, numOutputs);
+}
+
+template<size_t numActivePhases>
+TruePeakOversampler::Peaks TruePeakOversampler::processContiguous(const float* input, size_t numOutputs) const
+{
+    size_t outputIndex = 0;
+    Peaks peaks;
+
+#if defined(LUFS_OVERSAMPLER_SSE)
+    //Four consecutive outputs of every phase at once, each input is loaded once and used by all the phases
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 truePeaks = _mm_setzero_ps();
+    __m128 samplePeaks = _mm_setzero_ps();
+
+    for(; outputIndex + 4 <= numOutputs; outputIndex += 4)
+    {
+        __m128 phaseOutputs[numActivePhases];
+
+        for(size_t phase = 0; phase < numActivePhases; ++phase)
+        {
+            phaseOutputs[phase] = _mm_setzero_ps();
+        }
+
+        for(size_t tap = 0; tap < tapsPerPhase; ++tap)
+        {
+            const __m128 inputs = _mm_loadu_ps(input + outputIndex + tap);
+
+            //The last tap lines up with the new samples
+            if(tap == tapsPerPhase - 1)
+            {
+                samplePeaks = _mm_max_ps(samplePeaks, _mm_and_ps(inputs, absMask));
+            }
+
+            for(size_t phase = 0; phase < numActivePhases; ++phase)
+            {
+                phaseOutputs[phase] = _mm_add_ps(phaseOutputs[phase], _mm_mul_ps(_mm_set1_ps(activePhases[phase][tap]), inputs));
+            }
+        }
+
+        for(size_t phase = 0; phase < numActivePhases; ++phase)
+        {
+            truePeaks = _mm_max_ps(truePeaks, _mm_and_ps(phaseOutputs[phase], absMask));
+        }
+    }
+
+    alignas(16) float lanePeaks[4];
+
+    _mm_store_ps(lanePeaks, truePeaks);
+    peaks.truePeak = *std::max_element(std::begin(lanePeaks), std::end(lanePeaks));
+
+    _mm_store_ps(lanePeaks, samplePeaks);
+    peaks.samplePeak = *std::max_element(std::begin(lanePeaks), std::end(lanePeaks));
+#endif
+
+    for(; outputIndex < numOutputs; ++outputIndex)
+    {
+        peaks.samplePeak = std::max(peaks.samplePeak, std::abs(input[outputIndex + historyLength]));
+
+        for(size_t phase = 0; phase < numActivePhases; ++phase)
+        {
+            float output = 0.0f;
+
+            for(size_t tap = 0; tap < tapsPerPhase; ++tap)
+            {
+                output += activePhases[phase][tap] * input[outputIndex + tap];
+            }
+
+            peaks.truePeak = std::max(peaks.truePeak, std::abs(output));
+        }
+    }
+
+    return peaks;
+}
+
+float TruePeakOversampler::findSamplePeak(const float* samples, size_t numSamples)
+{
+    size_t sampleIndex = 0;
+    float peak = 0.0f;
+
+#if defined(LUFS_OVERSAMPLER_SSE)
+    //Two independent maxima so consecutive maxes don't wait on each other
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 firstPeaks = _mm_setzero_ps();
+    __m128 secondPeaks = _mm_setzero_ps();
+
+    for(; sampleIndex + 8 <= numSamples; sampleIndex += 8)
+    {
+        firstPeaks = _mm_max_ps(firstPeaks, _mm_and_ps(_mm_loadu_ps(samples + sampleIndex), absMask));
+        secondPeaks = _mm_max_ps(secondPeaks, _mm_and_ps(_mm_loadu_ps(samples + sampleIndex + 4), absMask));
+    }
+
+    alignas(16) float lanePeaks[4];
+    _mm_store_ps(lanePeaks, _mm_max_ps(firstPeaks, secondPeaks));
+    peak = *std::max_element(std::begin(lanePeaks), std::end(lanePeaks));
+#endif
+
+    for(; sampleIndex < numSamples; ++sampleIndex)
+    {
+        peak = std::max(peak, std::abs(samples[sampleIndex]));
+    }
+
+    return peak;
+}
+
+void TruePeakOversampler::deinterleave(const float* interleaved, size_t numChannels, size_t numFrames, float* planar, size_t planarStride)
+{
+    size_t frameIndex = 0;
+
+#if defined(LUFS_OVERSAMPLER_SSE)
+    //Four frames at a time, stereo is split with two shuffles and groups of four channels are transposed
+    if(numChannels == 2)
+    {
+        for(; frameIndex + 4 <= numFrames; frameIndex += 4)
+        {
+            const __m128 firstFrames = _mm_loadu_ps(interleaved + frameIndex * 2);
+            const __m128 lastFrames = _mm_loadu_ps(interleaved + frameIndex * 2 + 4);
+
+            _mm_storeu_ps(planar + frameIndex, _mm_shuffle_ps(firstFrames, lastFrames, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(planar + planarStride + frameIndex, _mm_shuffle_ps(firstFrames, lastFrames, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    }
+    else if(numChannels % 4 == 0)
+    {
+        for(; frameIndex + 4 <= numFrames; frameIndex += 4)
+        {
+            const float* const frames = interleaved + frameIndex * numChannels;
+
+            for(size_t channelIndex = 0; channelIndex < numChannels; channelIndex += 4)
+            {
+                __m128 frame0 = _mm_loadu_ps(frames + channelIndex);
+                __m128 frame1 = _mm_loadu_ps(frames + numChannels + channelIndex);
+                __m128 frame2 = _mm_loadu_ps(frames + numChannels * 2 + channelIndex);
+                __m128 frame3 = _mm_loadu_ps(frames + numChannels * 3 + channelIndex);
+
+                _MM_TRANSPOSE4_PS(frame0, frame1, frame2, frame3);
+
+                float* const channels = planar + channelIndex * planarStride + frameIndex;
+
+                _mm_storeu_ps(channels, frame0);
+                _mm_storeu_ps(channels + planarStride, frame1);
+                _mm_storeu_ps(channels + planarStride * 2, frame2);
+                _mm_storeu_ps(channels + planarStride * 3, frame3);
+            }
+        }
+    }
+#endif
+
+    //Other layouts and any frames left over are copied one sample at a time
+    for(; frameIndex < numFrames; ++frameIndex)
+    {
+        for(size_t channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+        {
+            planar[channelIndex * planarStride + frameIndex] = interleaved[frameIndex * numChannels + channelIndex];
+        }
+    }
+}
+
+}
@@ -2,94 +2,86 @@
 
 #include <filesystem>
 #include <cassert>
+#include <numbers>
+#include <memory_resource>
+#include <random>
+#include <thread>
+#include <atomic>
 
 #define DR_WAV_IMPLEMENTATION
 #include "dr_wav.h"
 
+#include "TestHelpers.h"
+
 #include "FixedTermLoudnessMeter.h"
 #include "IntegratedLoudnessMeter.h"
 #include "TruePeakMeter.h"
+#include "LoudnessAnalyser.h"
+#include "OfflineLoudnessAnalyser.h"
+#include "MeterBank.h"
+#include "SnapshotPublisher.h"
+#include "ChannelProcessor.h"
+#include "KWeightingKernel.h"
 
-std::optional<std::filesystem::path> getTestContentPath()
-{
-    const std::filesystem::path path = std::filesystem::current_path() / "test_content";
-    std::cout << path << std::endl;
-
-    return std::filesystem::exists(path) ? path : std::optional<std::filesystem::path>(std::nullopt);
-}
-
-std::unique_ptr<drwav> openTestFile(std::string_view testFileName)
+TEST(EBU3341_Test_Set, Test_1)
 {
-    const std::optional<std::filesystem::path> contentPath = getTestContentPath();
-    
-    if(!contentPath)
-    {
-        return nullptr;
-    }
+    const std::string testFileName = "seq-3341-1-16bit.wav";
     
-    const std::filesystem::path filePath = *contentPath / testFileName;
-    const auto filePathString = filePath.string();
-
-    std::unique_ptr<drwav> audioFile = std::make_unique<drwav>();
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
     
-    if(!drwav_init_file(audioFile.get(), filePathString.c_str(), nullptr))
+    if(!audioFile)
     {
-        return nullptr;
+        FAIL() << "Failed to open test file: " << testFileName;
     }
     
-    return audioFile;
-}
-
-std::vector<LUFS::Channel> createStereoConfig()
-{
-    return {
-        LUFS::Channel::createStandard(LUFS::StandardChannel::Left), 
-        LUFS::Channel::createStandard(LUFS::StandardChannel::Right)
-    };
-}
-
-std::vector<LUFS::Channel> create5point0Config()
-{
-    return {
-        LUFS::Channel::createStandard(LUFS::StandardChannel::Left), 
-        LUFS::Channel::createStandard(LUFS::StandardChannel::Right),
-        LUFS::Channel::createStandard(LUFS::StandardChannel::Centre), 
-        LUFS::Channel::createStandard(LUFS::StandardChannel::LeftSurround),
-        LUFS::Channel::createStandard(LUFS::StandardChannel::RightSurround),
-    };
-}
-
-void processFile(drwav& file, std::function<void(const std::vector<std::vector<float>>&)> audioBufferCallback, int maxBufferSize)
-{
-    assert(audioBufferCallback);
+    const int maxBufferSize = 1024;
+    const int numChannels = 2;
     
-    std::vector<float> interleavedBuffer(file.channels * maxBufferSize);
-    std::vector<std::vector<float>> deinterleavedBuffer(file.channels);
-    uint64_t numFramesRead = maxBufferSize;
+    std::vector<float> interleavedBuffer(numChannels * maxBufferSize, 0.0f);
+    
+    LUFS::FixedTermLoudnessMeter momentaryMeter(createStereoConfig(), std::chrono::milliseconds(400));
+    LUFS::FixedTermLoudnessMeter shortTermMeter(createStereoConfig(), std::chrono::milliseconds(3000));
+    LUFS::IntegratedLoudnessMeter integratedMeter(createStereoConfig());
     
-    while(numFramesRead >= maxBufferSize)
+    const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
     {
-        numFramesRead = drwav_read_pcm_frames_f32(&file, maxBufferSize, interleavedBuffer.data());
+        const size_t numSamples = buffer[0].size();
         
-        //Resize each channel and deinterleave samples
-        size_t channelIndex = 0;
-        std::for_each(deinterleavedBuffer.begin(), deinterleavedBuffer.end(), [&](std::vector<float>& channelBuffer)
+        interleavedBuffer.resize(numChannels * numSamples);
+        
+        for(int channelIndex = 0; channelIndex < numChannels; ++channelIndex)
         {
-            channelBuffer.resize(numFramesRead);
+            const float* channelData = buffer[channelIndex].data();
             
-            for(int sampleIndex = 0; sampleIndex < numFramesRead; ++sampleIndex)
+            for(int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
             {
-                channelBuffer[sampleIndex] = interleavedBuffer[sampleIndex * file.channels + channelIndex];
+                interleavedBuffer[sampleIndex * numChannels + channelIndex] = *channelData;
+                ++channelData;
             }
-            
-            ++channelIndex;
-        });
+        }
         
-        audioBufferCallback(deinterleavedBuffer);
-    }
+        momentaryMeter.process(interleavedBuffer);
+        shortTermMeter.process(interleavedBuffer);
+        integratedMeter.process(interleavedBuffer);
+    };
+    
+    processFile(*audioFile, audioBufferCallback, maxBufferSize);
+    
+    const float momentaryLoudness = momentaryMeter.getLoudness();
+    const float shortTermLoudness = shortTermMeter.getLoudness();
+    const float integratedLoudness = integratedMeter.getLoudness();
+    
+    ASSERT_LE(momentaryLoudness, -22.9f);
+    ASSERT_GE(momentaryLoudness, -23.1f);
+    
+    ASSERT_LE(shortTermLoudness, -22.9f);
+    ASSERT_GE(shortTermLoudness, -23.1f);
+    
+    ASSERT_LE(integratedLoudness, -22.9f);
+    ASSERT_GE(integratedLoudness, -23.1f);
 }
 
-TEST(EBU3341_Test_Set, Test_1)
+TEST(EBU3341_Test_Set, Test_1_Loudness_Analyser)
 {
     const std::string testFileName = "seq-3341-1-16bit.wav";
     
@@ -105,9 +97,7 @@ TEST(EBU3341_Test_Set, Test_1)
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize, 0.0f);
     
-    LUFS::FixedTermLoudnessMeter momentaryMeter(createStereoConfig(), std::chrono::milliseconds(400));
-    LUFS::FixedTermLoudnessMeter shortTermMeter(createStereoConfig(), std::chrono::milliseconds(3000));
-    LUFS::IntegratedLoudnessMeter integratedMeter(createStereoConfig());
+    LUFS::LoudnessAnalyser analyser(createStereoConfig());
     
     const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
     {
@@ -126,16 +116,14 @@ TEST(EBU3341_Test_Set, Test_1)
             }
         }
         
-        momentaryMeter.process(interleavedBuffer);
-        shortTermMeter.process(interleavedBuffer);
-        integratedMeter.process(interleavedBuffer);
+        analyser.process(interleavedBuffer);
     };
     
     processFile(*audioFile, audioBufferCallback, maxBufferSize);
     
-    const float momentaryLoudness = momentaryMeter.getLoudness();
-    const float shortTermLoudness = shortTermMeter.getLoudness();
-    const float integratedLoudness = integratedMeter.getLoudness();
+    const float momentaryLoudness = analyser.getMomentaryLoudness();
+    const float shortTermLoudness = analyser.getShortTermLoudness();
+    const float integratedLoudness = analyser.getIntegratedLoudness();
     
     ASSERT_LE(momentaryLoudness, -22.9f);
     ASSERT_GE(momentaryLoudness, -23.1f);
@@ -147,6 +135,281 @@ TEST(EBU3341_Test_Set, Test_1)
     ASSERT_GE(integratedLoudness, -23.1f);
 }
 
+TEST(EBU3341_Test_Set, Test_1_Sample_Rates)
+{
+    //The test files are all 48kHz so test 1 is synthesised at other rates instead
+    const std::vector<double> sampleRates{44100.0, 48000.0, 88200.0, 96000.0, 192000.0};
+    const int numChannels = 2;
+    const double testSeconds = 20.0;
+    const double amplitude = std::pow(10.0, -23.0 / 20.0);
+    const double frequency = 1000.0;
+    
+    std::for_each(sampleRates.begin(), sampleRates.end(), [&](double sampleRate)
+    {
+        const size_t numFrames = static_cast<size_t>(sampleRate * testSeconds);
+        std::vector<float> interleavedBuffer(numChannels * numFrames, 0.0f);
+        
+        for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+        {
+            const float sample = static_cast<float>(amplitude * std::sin(2.0 * std::numbers::pi * frequency * frameIndex / sampleRate));
+            
+            interleavedBuffer[frameIndex * numChannels] = sample;
+            interleavedBuffer[frameIndex * numChannels + 1] = sample;
+        }
+        
+        LUFS::IntegratedLoudnessMeter integratedMeter(sampleRate, createStereoConfig());
+        LUFS::FixedTermLoudnessMeter shortTermMeter(sampleRate, createStereoConfig(), std::chrono::milliseconds(3000));
+        
+        integratedMeter.process(interleavedBuffer);
+        shortTermMeter.process(interleavedBuffer);
+        
+        EXPECT_NEAR(integratedMeter.getLoudness(), -23.0f, 0.1f) << "Sample rate: " << sampleRate;
+        EXPECT_NEAR(shortTermMeter.getLoudness(), -23.0f, 0.1f) << "Sample rate: " << sampleRate;
+    });
+}
+
+TEST(EBU3341_Test_Set, Test_1_Memory_Resource)
+{
+    const int numChannels = 2;
+    const double sampleRate = 48000.0;
+    const size_t numFrames = static_cast<size_t>(sampleRate * 20.0);
+    const double amplitude = std::pow(10.0, -23.0 / 20.0);
+    
+    std::vector<float> interleavedBuffer(numChannels * numFrames, 0.0f);
+    
+    for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+    {
+        const float sample = static_cast<float>(amplitude * std::sin(2.0 * std::numbers::pi * 1000.0 * frameIndex / sampleRate));
+        
+        interleavedBuffer[frameIndex * numChannels] = sample;
+        interleavedBuffer[frameIndex * numChannels + 1] = sample;
+    }
+    
+    //Every allocation must come from the arena, running out would throw rather than fall back to the heap
+    std::vector<std::byte> arenaMemory(2 * 1024 * 1024);
+    std::pmr::monotonic_buffer_resource arena(arenaMemory.data(), arenaMemory.size(), std::pmr::null_memory_resource());
+    
+    LUFS::IntegratedLoudnessMeter integratedMeter(sampleRate, createStereoConfig(), -100.0f, &arena);
+    LUFS::FixedTermLoudnessMeter momentaryMeter(sampleRate, createStereoConfig(), std::chrono::milliseconds(400), -100.0f, LUFS::FixedTermLoudnessMeter::Resolution::Sample, &arena);
+    LUFS::TruePeakMeter truePeakMeter(sampleRate, numChannels, -100.0f, &arena);
+    
+    //Only the bank's threads are allocated outside of the arena
+    const size_t numStreams = 3;
+    LUFS::MeterBank meterBank(sampleRate, createStereoConfig(), numStreams, LUFS::MeterBank::Measurements::MomentaryShortTermAndIntegrated, 2, -100.0f, &arena);
+    
+    integratedMeter.process(interleavedBuffer);
+    momentaryMeter.process(interleavedBuffer);
+    truePeakMeter.process(interleavedBuffer);
+    
+    const std::vector<std::span<const float>> streamAudio(numStreams, interleavedBuffer);
+    meterBank.process(streamAudio);
+    meterBank.processLockstep(std::vector<float>(numStreams * numChannels * 4800, 0.0f));
+    
+    std::vector<LUFS::MeterBank::Readout> readouts(numStreams);
+    meterBank.getReadouts(readouts);
+    
+    EXPECT_NEAR(integratedMeter.getLoudness(), -23.0f, 0.1f);
+    EXPECT_NEAR(momentaryMeter.getLoudness(), -23.0f, 0.1f);
+    EXPECT_NEAR(truePeakMeter.getTruePeak(), -23.0f, 0.1f);
+    
+    for(const LUFS::MeterBank::Readout& readout : readouts)
+    {
+        EXPECT_NEAR(readout.integratedLoudness, -23.0f, 0.1f);
+    }
+}
+
+TEST(EBU3341_Test_Set, Test_1_Kernel_Instruction_Sets)
+{
+    //Each lane is test 1's tone at a different level with noise added, so no two lanes filter the same samples
+    //The lane counts cover a lone lane, odd lanes left after pairing and lanes left after the AVX2 groups
+    //Results are compared exactly, which relies on the filter sources being built without fused multiply adds, see CMakeLists.txt
+    const double sampleRate = 48000.0;
+    const size_t numFrames = 4800;
+    const size_t firstCallFrames = 1013;
+    const std::vector<size_t> laneCounts{1, 3, 5, 6, 9};
+    
+    const LUFS::KWeightingKernel::Coefficients coefficients = LUFS::ChannelProcessor::calculateKernelCoefficients(sampleRate);
+    
+    std::vector<LUFS::KWeightingKernel::InstructionSet> instructionSets{LUFS::KWeightingKernel::InstructionSet::Scalar};
+    
+    if(LUFS::KWeightingKernel::getInstructionSet() != LUFS::KWeightingKernel::InstructionSet::Scalar)
+    {
+        instructionSets.push_back(LUFS::KWeightingKernel::InstructionSet::SSE2);
+    }
+    
+    if(LUFS::KWeightingKernel::getInstructionSet() == LUFS::KWeightingKernel::InstructionSet::AVX2)
+    {
+        instructionSets.push_back(LUFS::KWeightingKernel::InstructionSet::AVX2);
+    }
+    
+    std::mt19937 randomEngine(3341);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    
+    std::for_each(laneCounts.begin(), laneCounts.end(), [&](size_t numLanes)
+    {
+        std::vector<float> interleavedBuffer(numLanes * numFrames);
+        
+        for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+        {
+            for(size_t lane = 0; lane < numLanes; ++lane)
+            {
+                const double amplitude = std::pow(10.0, (-23.0 - 3.0 * lane) / 20.0);
+                interleavedBuffer[frameIndex * numLanes + lane] = static_cast<float>(amplitude * std::sin(2.0 * std::numbers::pi * 1000.0 * frameIndex / sampleRate)) + noise(randomEngine);
+            }
+        }
+        
+        //The samples of filterSample and the sums of squares of filterBlock are what every kernel should give exactly
+        std::vector<float> expectedOutput(interleavedBuffer.size());
+        std::vector<double> expectedSumsOfSquares(numLanes, 0.0);
+        
+        for(size_t lane = 0; lane < numLanes; ++lane)
+        {
+            LUFS::ChannelProcessor sampleProcessor(1.0f, 0, sampleRate);
+            LUFS::ChannelProcessor blockProcessor(1.0f, 0, sampleRate);
+            
+            std::vector<float> channelBuffer(numFrames);
+            
+            for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+            {
+                channelBuffer[frameIndex] = interleavedBuffer[frameIndex * numLanes + lane];
+                expectedOutput[frameIndex * numLanes + lane] = sampleProcessor.filterSample(channelBuffer[frameIndex]);
+            }
+            
+            expectedSumsOfSquares[lane] = blockProcessor.filterBlock({channelBuffer.data(), firstCallFrames});
+            expectedSumsOfSquares[lane] += blockProcessor.filterBlock({channelBuffer.data() + firstCallFrames, numFrames - firstCallFrames});
+        }
+        
+        std::for_each(instructionSets.begin(), instructionSets.end(), [&](LUFS::KWeightingKernel::InstructionSet instructionSet)
+        {
+            std::vector<LUFS::KWeightingKernel::LaneState> states(numLanes);
+            std::vector<double> sumsOfSquares(numLanes, 0.0);
+            std::vector<float> output(interleavedBuffer.size());
+            
+            //Split in two so the state must carry over between calls
+            LUFS::KWeightingKernel::process(instructionSet, coefficients, states.data(), interleavedBuffer.data(), numLanes, numLanes, firstCallFrames, sumsOfSquares.data(), output.data());
+            LUFS::KWeightingKernel::process(instructionSet, coefficients, states.data(), interleavedBuffer.data() + firstCallFrames * numLanes, numLanes, numLanes, numFrames - firstCallFrames, sumsOfSquares.data(), output.data() + firstCallFrames * numLanes);
+            
+            for(size_t lane = 0; lane < numLanes; ++lane)
+            {
+                ASSERT_EQ(sumsOfSquares[lane], expectedSumsOfSquares[lane]) << "Instruction set: " << static_cast<int>(instructionSet) << " lanes: " << numLanes << " lane: " << lane;
+            }
+            
+            for(size_t sampleIndex = 0; sampleIndex < output.size(); ++sampleIndex)
+            {
+                ASSERT_EQ(output[sampleIndex], expectedOutput[sampleIndex]) << "Instruction set: " << static_cast<int>(instructionSet) << " lanes: " << numLanes << " sample: " << sampleIndex;
+            }
+        });
+    });
+}
+
+TEST(EBU3341_Test_Set, Test_1_Running_Sum_Drift)
+{
+    //Each cycle is loud noise followed by noise 120dB quieter, the running sum of squares has to take away the loud squares again as they leave the block
+    //Any rounding error left over from the loud blocks would swamp the quiet ones, so once a block is entirely quiet the running sum must match a fresh sum
+    const double sampleRate = 48000.0;
+    const size_t blockLengthSamples = 4800;
+    const size_t numLoudBlocks = 2;
+    const size_t numQuietBlocks = 3;
+    const size_t numCycles = 100;
+    const size_t checkInterval = 480;
+    const float loudAmplitude = 1.0f;
+    const float quietAmplitude = 1.0e-6f;
+    
+    LUFS::ChannelProcessor processor(1.0f, blockLengthSamples, sampleRate);
+    
+    std::mt19937 randomGenerator(1770);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    
+    for(size_t cycleIndex = 0; cycleIndex < numCycles; ++cycleIndex)
+    {
+        for(size_t blockIndex = 0; blockIndex < numLoudBlocks + numQuietBlocks; ++blockIndex)
+        {
+            const float amplitude = blockIndex < numLoudBlocks ? loudAmplitude : quietAmplitude;
+            
+            //Only the last quiet block is checked, as the block before it was quiet too nothing loud has been stored since the last wrap
+            const bool checkBlock = blockIndex == numLoudBlocks + numQuietBlocks - 1;
+            
+            for(size_t sampleIndex = 0; sampleIndex < blockLengthSamples; ++sampleIndex)
+            {
+                processor.storeSample(sampleIndex, amplitude * noise(randomGenerator));
+                
+                if(checkBlock && sampleIndex % checkInterval == 0)
+                {
+                    double freshSumSquares = 0.0;
+                    
+                    for(const float sample : processor.currentBlockData)
+                    {
+                        freshSumSquares += double(sample) * double(sample);
+                    }
+                    
+                    const double expectedMeanSquares = freshSumSquares / blockLengthSamples;
+                    
+                    ASSERT_NEAR(processor.getRunningBlockMeanSquares(), expectedMeanSquares, expectedMeanSquares * 1.0e-5) << "Cycle: " << cycleIndex << " Sample: " << sampleIndex;
+                }
+            }
+        }
+    }
+}
+
+TEST(EBU3341_Test_Set, Test_1_Concurrent_Snapshots)
+{
+    //Another thread keeps publishing snapshots while this thread reads them, every field of a snapshot is worked out from its count
+    //A read that overlapped a publish and mixed two snapshots would have fields from different counts
+    struct Snapshot
+    {
+        uint64_t count = 0;
+        double half = 0.0;
+        double quarter = 0.0;
+        uint64_t countComplement = ~uint64_t(0);
+    };
+    
+    const uint64_t numReads = 5000000;
+    
+    LUFS::SnapshotPublisher<Snapshot> publisher(Snapshot{});
+    
+    std::atomic<bool> finished = false;
+    
+    std::atomic<uint64_t> numPublishes = 0;
+    
+    std::thread publishThread([&]()
+    {
+        for(uint64_t count = 1; !finished; ++count)
+        {
+            publisher.publish(Snapshot{count, count * 0.5, count * 0.25, ~count});
+            numPublishes.store(count, std::memory_order_relaxed);
+        }
+    });
+    
+    uint64_t numMixedReads = 0;
+    uint64_t numBackwardsReads = 0;
+    uint64_t lastCount = 0;
+    
+    for(uint64_t readIndex = 0; readIndex < numReads; ++readIndex)
+    {
+        const Snapshot snapshot = publisher.read();
+        
+        if(snapshot.half != snapshot.count * 0.5 || snapshot.quarter != snapshot.count * 0.25 || snapshot.countComplement != ~snapshot.count)
+        {
+            ++numMixedReads;
+        }
+        
+        //Snapshots are published in order so a later read never sees an older one
+        if(snapshot.count < lastCount)
+        {
+            ++numBackwardsReads;
+        }
+        
+        lastCount = snapshot.count;
+    }
+    
+    finished = true;
+    publishThread.join();
+    
+    ASSERT_EQ(numMixedReads, 0);
+    ASSERT_EQ(numBackwardsReads, 0);
+    ASSERT_EQ(publisher.read().count, numPublishes.load());
+}
+
 TEST(EBU3341_Test_Set, Test_2)
 {
     const std::string testFileName = "seq-3341-2-16bit.wav";
@@ -254,6 +517,53 @@ TEST(EBU3341_Test_Set, Test_3)
     ASSERT_GE(integratedLoudness, -23.1f);
 }
 
+TEST(EBU3341_Test_Set, Test_3_Merged_States)
+{
+    const std::string testFileName = "seq-3341-3-16bit-v02.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const int maxBufferSize = 1024;
+    const int numChannels = 2;
+    
+    std::vector<const float*> channelBuffers{numChannels, nullptr};
+    
+    //Each meter measures half of the file as if it was being analysed somewhere else
+    LUFS::IntegratedLoudnessMeter firstHalfMeter(createStereoConfig());
+    LUFS::IntegratedLoudnessMeter secondHalfMeter(createStereoConfig());
+    
+    const uint64_t halfNumFrames = audioFile->totalPCMFrameCount / 2;
+    uint64_t numFramesProcessed = 0;
+    
+    const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
+    {
+        std::transform(buffer.begin(), buffer.end(), channelBuffers.begin(), [](const std::vector<float>& channelData)
+        {
+            return channelData.data();
+        });
+        
+        LUFS::IntegratedLoudnessMeter& meter = numFramesProcessed < halfNumFrames ? firstHalfMeter : secondHalfMeter;
+        meter.process(channelBuffers, buffer[0].size());
+        
+        numFramesProcessed += buffer[0].size();
+    };
+    
+    processFile(*audioFile, audioBufferCallback, maxBufferSize);
+    
+    LUFS::LoudnessHistogramState mergedState = firstHalfMeter.getState();
+    mergedState.merge(secondHalfMeter.getState());
+    
+    const float integratedLoudness = LUFS::IntegratedLoudnessMeter::calculateLoudness(mergedState);
+    
+    ASSERT_LE(integratedLoudness, -22.9f);
+    ASSERT_GE(integratedLoudness, -23.1f);
+}
+
 TEST(EBU3341_Test_Set, Test_4)
 {
     const std::string testFileName = "seq-3341-4-16bit-v02.wav";
@@ -470,6 +780,196 @@ TEST(EBU3341_Test_Set, Test_7)
     ASSERT_GE(integratedLoudness, -23.1f);
 }
 
+TEST(EBU3341_Test_Set, Test_7_Offline_Analysis)
+{
+    const std::string testFileName = "seq-3341-7_seq-3342-5-24bit.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const int numChannels = 2;
+    
+    //Read the whole programme into memory
+    std::vector<float> programme(numChannels * audioFile->totalPCMFrameCount, 0.0f);
+    const uint64_t numFramesRead = drwav_read_pcm_frames_f32(audioFile.get(), audioFile->totalPCMFrameCount, programme.data());
+    programme.resize(numChannels * numFramesRead);
+    
+    LUFS::IntegratedLoudnessMeter integratedMeter(createStereoConfig());
+    integratedMeter.process(programme);
+    
+    LUFS::OfflineLoudnessAnalyser offlineAnalyser(createStereoConfig(), 4);
+    const LUFS::LoudnessHistogramState state = offlineAnalyser.analyse(programme);
+    
+    const float integratedLoudness = LUFS::IntegratedLoudnessMeter::calculateLoudness(state);
+    
+    //The chunks are primed so no gating blocks are lost at the joins
+    ASSERT_EQ(state.getNumBlocks(), integratedMeter.getState().getNumBlocks());
+    ASSERT_NEAR(integratedLoudness, integratedMeter.getLoudness(), 0.001f);
+    
+    ASSERT_LE(integratedLoudness, -22.9f);
+    ASSERT_GE(integratedLoudness, -23.1f);
+}
+
+TEST(EBU3341_Test_Set, Test_7_Meter_Bank)
+{
+    const std::string testFileName = "seq-3341-7_seq-3342-5-24bit.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const int maxBufferSize = 1024;
+    const int numChannels = 2;
+    const size_t numStreams = 4;
+    
+    //Each stream is the programme 1dB quieter than the last
+    std::vector<std::vector<float>> streamBuffers(numStreams);
+    std::vector<std::span<const float>> streamAudio(numStreams);
+    
+    LUFS::MeterBank meterBank(createStereoConfig(), numStreams, LUFS::MeterBank::Measurements::MomentaryShortTermAndIntegrated, 2);
+    
+    const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
+    {
+        const size_t numSamples = buffer[0].size();
+        
+        for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+        {
+            const float gain = std::pow(10.0f, -static_cast<float>(streamIndex) / 20.0f);
+            
+            std::vector<float>& streamBuffer = streamBuffers[streamIndex];
+            streamBuffer.resize(numChannels * numSamples);
+            
+            for(int channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+            {
+                for(size_t sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+                {
+                    streamBuffer[sampleIndex * numChannels + channelIndex] = gain * buffer[channelIndex][sampleIndex];
+                }
+            }
+            
+            streamAudio[streamIndex] = streamBuffer;
+        }
+        
+        meterBank.process(streamAudio);
+    };
+    
+    processFile(*audioFile, audioBufferCallback, maxBufferSize);
+    
+    std::vector<LUFS::MeterBank::Readout> readouts(numStreams);
+    meterBank.getReadouts(readouts);
+    
+    for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+    {
+        const float expectedLoudness = -23.0f - static_cast<float>(streamIndex);
+        
+        ASSERT_LE(readouts[streamIndex].integratedLoudness, expectedLoudness + 0.1f);
+        ASSERT_GE(readouts[streamIndex].integratedLoudness, expectedLoudness - 0.1f);
+    }
+}
+
+TEST(EBU3341_Test_Set, Test_7_Meter_Bank_Lockstep)
+{
+    const std::string testFileName = "seq-3341-7_seq-3342-5-24bit.wav";
+    
+    const int maxBufferSize = 1024;
+    const int numChannels = 2;
+    
+    //10 lanes isn't a multiple of the SIMD lane width so some are filtered on their own
+    const size_t numStreams = 5;
+    
+    //With a lead in each stream starts at a different point in its sub blocks, so lockstep processing has to handle them one at a time
+    for(const size_t leadInStep : {size_t(0), size_t(7)})
+    {
+        std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+        
+        if(!audioFile)
+        {
+            FAIL() << "Failed to open test file: " << testFileName;
+        }
+        
+        LUFS::MeterBank lockstepMeterBank(createStereoConfig(), numStreams, LUFS::MeterBank::Measurements::MomentaryShortTermAndIntegrated, 2);
+        LUFS::MeterBank meterBank(createStereoConfig(), numStreams, LUFS::MeterBank::Measurements::MomentaryShortTermAndIntegrated, 2);
+        
+        std::vector<std::vector<float>> streamBuffers(numStreams);
+        std::vector<std::span<const float>> streamAudio(numStreams);
+        
+        for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+        {
+            streamBuffers[streamIndex].assign(numChannels * streamIndex * leadInStep, 0.0f);
+            streamAudio[streamIndex] = streamBuffers[streamIndex];
+        }
+        
+        lockstepMeterBank.process(streamAudio);
+        meterBank.process(streamAudio);
+        
+        std::vector<float> lockstepBuffer;
+        
+        std::vector<LUFS::MeterBank::Readout> lockstepReadouts(numStreams);
+        std::vector<LUFS::MeterBank::Readout> readouts(numStreams);
+        
+        const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
+        {
+            const size_t numSamples = buffer[0].size();
+            
+            lockstepBuffer.resize(numStreams * numChannels * numSamples);
+            
+            //Each stream is the programme 1dB quieter than the last
+            for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+            {
+                const float gain = std::pow(10.0f, -static_cast<float>(streamIndex) / 20.0f);
+                
+                std::vector<float>& streamBuffer = streamBuffers[streamIndex];
+                streamBuffer.resize(numChannels * numSamples);
+                
+                for(int channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+                {
+                    for(size_t sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+                    {
+                        const float sample = gain * buffer[channelIndex][sampleIndex];
+                        
+                        streamBuffer[sampleIndex * numChannels + channelIndex] = sample;
+                        lockstepBuffer[(sampleIndex * numStreams + streamIndex) * numChannels + channelIndex] = sample;
+                    }
+                }
+                
+                streamAudio[streamIndex] = streamBuffer;
+            }
+            
+            lockstepMeterBank.processLockstep(lockstepBuffer);
+            meterBank.process(streamAudio);
+            
+            lockstepMeterBank.getReadouts(lockstepReadouts);
+            meterBank.getReadouts(readouts);
+            
+            for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+            {
+                ASSERT_EQ(lockstepReadouts[streamIndex].momentaryLoudness, readouts[streamIndex].momentaryLoudness);
+                ASSERT_EQ(lockstepReadouts[streamIndex].shortTermLoudness, readouts[streamIndex].shortTermLoudness);
+                ASSERT_EQ(lockstepReadouts[streamIndex].integratedLoudness, readouts[streamIndex].integratedLoudness);
+            }
+        };
+        
+        processFile(*audioFile, audioBufferCallback, maxBufferSize);
+        
+        lockstepMeterBank.getReadouts(lockstepReadouts);
+        
+        for(size_t streamIndex = 0; streamIndex < numStreams; ++streamIndex)
+        {
+            const float expectedLoudness = -23.0f - static_cast<float>(streamIndex);
+            
+            ASSERT_LE(lockstepReadouts[streamIndex].integratedLoudness, expectedLoudness + 0.1f);
+            ASSERT_GE(lockstepReadouts[streamIndex].integratedLoudness, expectedLoudness - 0.1f);
+        }
+    }
+}
+
 TEST(EBU3341_Test_Set, Test_8)
 {
     const std::string testFileName = "seq-3341-2011-8_seq-3342-6-24bit-v02.wav";
@@ -589,6 +1089,66 @@ TEST(EBU3341_Test_Set, Test_9)
     std::cout << "Longest meter processing time: " << longestProcessDuration.count() << " microseconds" << std::endl;
 }
 
+TEST(EBU3341_Test_Set, Test_9_Sub_Block_Resolution)
+{
+    const std::string testFileName = "seq-3341-9-24bit.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const int maxBufferSize = 1024;
+    const int numChannels = 2;
+    const int constantTimeThresholdSamples = 48000 * 3;
+    
+    std::vector<const float*> channelBuffers{numChannels, nullptr};
+    
+    LUFS::FixedTermLoudnessMeter shortTermMeter(createStereoConfig(), std::chrono::milliseconds(3000), -100.0f, LUFS::FixedTermLoudnessMeter::Resolution::SubBlock);
+    
+    std::chrono::microseconds longestProcessDuration(0);
+    
+    size_t totalNumSamplesProcessed = 0;
+    
+    const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
+    {
+        const int numSamples = buffer[0].size();
+        
+        std::transform(buffer.begin(), buffer.end(), channelBuffers.begin(), [](const std::vector<float>& channelData)
+        {
+            return channelData.data();
+        });
+        
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        
+        shortTermMeter.process(channelBuffers, numSamples);
+        
+        const auto endTime = std::chrono::high_resolution_clock::now();
+        
+        totalNumSamplesProcessed += numSamples;
+        
+        //Stability Check
+        if(totalNumSamplesProcessed >= constantTimeThresholdSamples)
+        {
+            const float shortTermLoudness = shortTermMeter.getLoudness();
+            
+            ASSERT_LE(shortTermLoudness, -22.9f);
+            ASSERT_GE(shortTermLoudness, -23.1f);
+        }
+        
+        if(endTime - startTime > longestProcessDuration)
+        {
+            longestProcessDuration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
+        }
+    };
+    
+    processFile(*audioFile, audioBufferCallback, 1024);
+    
+    std::cout << "Longest meter processing time: " << longestProcessDuration.count() << " microseconds" << std::endl;
+}
+
 TEST(EBU3341_Test_Set, Test_10)
 {
     for(int testIndex = 0; testIndex < 20; ++testIndex)
@@ -901,7 +1461,7 @@ TEST(EBU3341_Test_Set, Test_15)
     const int numChannels = 2;
     
     std::vector<const float*> channelBuffers{numChannels, nullptr};
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -936,6 +1496,150 @@ TEST(EBU3341_Test_Set, Test_15)
     ASSERT_GE(maxTruePeak, -6.4f);
 }
 
+TEST(EBU3341_Test_Set, Test_15_Sample_Rates)
+{
+    //The test files are all 48kHz so a tone peaking at -6dBTP is synthesised at other rates instead
+    //It is the same 12kHz as the quarter sample rate tones at 48kHz, with each peak half way between two samples as that is where the sample peak is furthest from it
+    const std::vector<std::pair<double, int>> sampleRatesAndFactors{{48000.0, 4}, {96000.0, 2}, {192000.0, 1}};
+    const int numChannels = 2;
+    const double testSeconds = 1.0;
+    const double fadeSeconds = 0.1;
+    const double amplitude = 0.5;
+    const double frequency = 12000.0;
+    
+    std::for_each(sampleRatesAndFactors.begin(), sampleRatesAndFactors.end(), [&](const std::pair<double, int>& sampleRateAndFactor)
+    {
+        const auto [sampleRate, expectedFactor] = sampleRateAndFactor;
+        
+        const size_t numFrames = static_cast<size_t>(sampleRate * testSeconds);
+        const double phaseStep = 2.0 * std::numbers::pi * frequency / sampleRate;
+        std::vector<float> interleavedBuffer(numChannels * numFrames, 0.0f);
+        
+        for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+        {
+            //Faded in so the start of the tone doesn't overshoot
+            const double fade = std::min(1.0, frameIndex / (sampleRate * fadeSeconds));
+            const float sample = static_cast<float>(fade * amplitude * std::cos(phaseStep * (frameIndex + 0.5)));
+            
+            interleavedBuffer[frameIndex * numChannels] = sample;
+            interleavedBuffer[frameIndex * numChannels + 1] = sample;
+        }
+        
+        LUFS::TruePeakMeter meter(sampleRate, numChannels);
+        
+        ASSERT_EQ(meter.getOversamplingFactor(), expectedFactor) << "Sample rate: " << sampleRate;
+        
+        meter.process(interleavedBuffer);
+        
+        EXPECT_LE(meter.getTruePeak(), -5.8f) << "Sample rate: " << sampleRate;
+        EXPECT_GE(meter.getTruePeak(), -6.4f) << "Sample rate: " << sampleRate;
+    });
+}
+
+TEST(EBU3341_Test_Set, Test_15_Integer_Min_Level)
+{
+    //A min level written as an integer must select the current constructor rather than be taken as the deprecated max buffer size
+    const int numChannels = 2;
+    const std::vector<int> minLevels{-70, 0, 20};
+    
+    const std::vector<float> silentBuffer(numChannels * 1024, 0.0f);
+    
+    for(const int minLevel : minLevels)
+    {
+        LUFS::TruePeakMeter meter(48000.0, numChannels, minLevel);
+        
+        meter.process(silentBuffer);
+        
+        ASSERT_EQ(meter.getTruePeak(), static_cast<float>(minLevel));
+        ASSERT_EQ(meter.getSamplePeak(), static_cast<float>(minLevel));
+    }
+}
+
+TEST(EBU3341_Test_Set, Test_15_Concurrent_Reset)
+{
+    //Another thread processes test 15's tone and then silence while this thread resets
+    //The first silent call still rings from the tone, resetting during it must not let that be read once reset has returned
+    const double sampleRate = 48000.0;
+    const int numChannels = 2;
+    const size_t numFrames = 256;
+    const int numResets = 100;
+    
+    std::vector<float> toneBuffer(numChannels * numFrames);
+    const std::vector<float> silentBuffer(numChannels * numFrames, 0.0f);
+    
+    for(size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+    {
+        const float sample = static_cast<float>(0.5 * std::cos(std::numbers::pi / 2.0 * frameIndex));
+        
+        toneBuffer[frameIndex * numChannels] = sample;
+        toneBuffer[frameIndex * numChannels + 1] = sample;
+    }
+    
+    LUFS::TruePeakMeter meter(sampleRate, numChannels);
+    
+    std::atomic<bool> processTone = false;
+    std::atomic<bool> finished = false;
+    std::atomic<uint64_t> numCallsStarted = 0;
+    std::atomic<uint64_t> numCallsFinished = 0;
+    
+    std::thread processThread([&]()
+    {
+        while(!finished)
+        {
+            //Counted before the buffer is chosen, so a call counted after processTone changes sees the change
+            ++numCallsStarted;
+            meter.process(processTone ? toneBuffer : silentBuffer);
+            ++numCallsFinished;
+        }
+    });
+    
+    const auto waitUntilStarted = [&](uint64_t call)
+    {
+        while(numCallsStarted < call)
+        {
+            std::this_thread::yield();
+        }
+    };
+    
+    int numTonesMeasured = 0;
+    int numPeaksAfterReset = 0;
+    
+    for(int resetIndex = 0; resetIndex < numResets; ++resetIndex)
+    {
+        processTone = true;
+        
+        //Once the call after next has started the one before it has processed the tone
+        waitUntilStarted(numCallsStarted + 2);
+        
+        if(meter.getTruePeak() > -6.4f)
+        {
+            ++numTonesMeasured;
+        }
+        
+        processTone = false;
+        waitUntilStarted(numCallsStarted + 1);
+        
+        meter.reset();
+        
+        const uint64_t lastCall = numCallsFinished + 2;
+        
+        while(numCallsFinished < lastCall)
+        {
+            if(meter.getTruePeak() != -100.0f || meter.getSamplePeak() != -100.0f || meter.getTruePeak(0) != -100.0f || meter.getSamplePeak(1) != -100.0f)
+            {
+                ++numPeaksAfterReset;
+            }
+        }
+    }
+    
+    finished = true;
+    processThread.join();
+    
+    ASSERT_EQ(numTonesMeasured, numResets);
+    ASSERT_EQ(numPeaksAfterReset, 0);
+    ASSERT_EQ(meter.getTruePeak(), -100.0f);
+}
+
 TEST(EBU3341_Test_Set, Test_16)
 {
     const std::string testFileName = "seq-3341-16-24bit.wav.wav";
@@ -951,7 +1655,7 @@ TEST(EBU3341_Test_Set, Test_16)
     const int numChannels = 2;
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize);
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1004,7 +1708,7 @@ TEST(EBU3341_Test_Set, Test_17)
     const int numChannels = 2;
     
     std::vector<const float*> channelBuffers{numChannels, nullptr};
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1054,7 +1758,7 @@ TEST(EBU3341_Test_Set, Test_18)
     const int numChannels = 2;
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize);
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1092,6 +1796,71 @@ TEST(EBU3341_Test_Set, Test_18)
     ASSERT_GE(maxTruePeak, -6.4f);
 }
 
+TEST(EBU3341_Test_Set, Test_15_To_18_Channels)
+{
+    //The right channel is 6dB quieter so each channel must be measured on its own
+    const std::vector<std::string> testFileNames{"seq-3341-15-24bit.wav.wav", "seq-3341-16-24bit.wav.wav", "seq-3341-17-24bit.wav.wav", "seq-3341-18-24bit.wav.wav"};
+    const float rightGain = 0.5f;
+    const float rightOffset = 20.0f * std::log10(rightGain);
+    
+    std::for_each(testFileNames.begin(), testFileNames.end(), [&](const std::string& testFileName)
+    {
+        std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+        
+        if(!audioFile)
+        {
+            FAIL() << "Failed to open test file: " << testFileName;
+        }
+        
+        const int maxBufferSize = 1024;
+        const int numChannels = 2;
+        
+        std::vector<float> rightBuffer(maxBufferSize);
+        std::vector<const float*> channelBuffers{numChannels, nullptr};
+        LUFS::TruePeakMeter meter(48000.0, numChannels);
+        
+        const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
+        {
+            const size_t numSamples = buffer[0].size();
+            
+            rightBuffer.resize(numSamples);
+            
+            std::transform(buffer[1].begin(), buffer[1].end(), rightBuffer.begin(), [rightGain](float sample)
+            {
+                return sample * rightGain;
+            });
+            
+            channelBuffers[0] = buffer[0].data();
+            channelBuffers[1] = rightBuffer.data();
+            
+            meter.process(channelBuffers, numSamples);
+        };
+        
+        processFile(*audioFile, audioBufferCallback, maxBufferSize);
+        
+        const float leftTruePeak = meter.getTruePeak(0);
+        const float rightTruePeak = meter.getTruePeak(1);
+        
+        EXPECT_LE(leftTruePeak, -5.8f) << testFileName;
+        EXPECT_GE(leftTruePeak, -6.4f) << testFileName;
+        
+        EXPECT_LE(rightTruePeak, -5.8f + rightOffset) << testFileName;
+        EXPECT_GE(rightTruePeak, -6.4f + rightOffset) << testFileName;
+        
+        //Halving the samples halves the peaks exactly
+        EXPECT_NEAR(rightTruePeak - leftTruePeak, rightOffset, 0.001f) << testFileName;
+        EXPECT_NEAR(meter.getSamplePeak(1) - meter.getSamplePeak(0), rightOffset, 0.001f) << testFileName;
+        
+        //The samples themselves can't peak above the true peak
+        EXPECT_LE(meter.getSamplePeak(0), -5.8f) << testFileName;
+        EXPECT_LE(meter.getSamplePeak(1), -5.8f + rightOffset) << testFileName;
+        
+        //Without a channel the loudest channel is used
+        EXPECT_EQ(meter.getTruePeak(), leftTruePeak) << testFileName;
+        EXPECT_EQ(meter.getSamplePeak(), meter.getSamplePeak(0)) << testFileName;
+    });
+}
+
 TEST(EBU3341_Test_Set, Test_19)
 {
     const std::string testFileName = "seq-3341-19-24bit.wav.wav";
@@ -1107,7 +1876,7 @@ TEST(EBU3341_Test_Set, Test_19)
     const int numChannels = 2;
     
     std::vector<const float*> channelBuffers{numChannels, nullptr};
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1157,7 +1926,7 @@ TEST(EBU3341_Test_Set, Test_20)
     const int numChannels = 2;
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize);
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1210,7 +1979,7 @@ TEST(EBU3341_Test_Set, Test_21)
     const int numChannels = 2;
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize);
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1263,7 +2032,7 @@ TEST(EBU3341_Test_Set, Test_22)
     const int numChannels = 2;
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize);
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -1316,7 +2085,7 @@ TEST(EBU3341_Test_Set, Test_23)
     const int numChannels = 2;
     
     std::vector<float> interleavedBuffer(numChannels * maxBufferSize);
-    LUFS::TruePeakMeter meter(48000.0, numChannels, maxBufferSize);
+    LUFS::TruePeakMeter meter(48000.0, numChannels);
     
     float maxTruePeak = std::numeric_limits<float>::lowest();
     
@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+
+#include "TestHelpers.h"
+
+#include "LoudnessRangeMeter.h"
+
+float measureLoudnessRange(drwav& file, const std::vector<LUFS::Channel>& channels)
+{
+    const int maxBufferSize = 1024;
+    
+    std::vector<const float*> channelBuffers{channels.size(), nullptr};
+    
+    LUFS::LoudnessRangeMeter loudnessRangeMeter(channels);
+    
+    std::chrono::microseconds longestProcessDuration(0);
+    
+    const auto audioBufferCallback = [&](const std::vector<std::vector<float>>& buffer)
+    {
+        std::transform(buffer.begin(), buffer.end(), channelBuffers.begin(), [](const std::vector<float>& channelData)
+        {
+            return channelData.data();
+        });
+        
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        
+        loudnessRangeMeter.process(channelBuffers, buffer[0].size());
+        
+        const auto endTime = std::chrono::high_resolution_clock::now();
+        
+        if(endTime - startTime > longestProcessDuration)
+        {
+            longestProcessDuration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
+        }
+    };
+    
+    processFile(file, audioBufferCallback, maxBufferSize);
+    
+    std::cout << "Longest meter processing time: " << longestProcessDuration.count() << " microseconds" << std::endl;
+    
+    return loudnessRangeMeter.getLoudnessRange();
+}
+
+TEST(EBU3342_Test_Set, Test_1)
+{
+    const std::string testFileName = "seq-3342-1-16bit.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const float loudnessRange = measureLoudnessRange(*audioFile, createStereoConfig());
+    
+    ASSERT_LE(loudnessRange, 11.0f);
+    ASSERT_GE(loudnessRange, 9.0f);
+}
+
+TEST(EBU3342_Test_Set, Test_2)
+{
+    const std::string testFileName = "seq-3342-2-16bit.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const float loudnessRange = measureLoudnessRange(*audioFile, createStereoConfig());
+    
+    ASSERT_LE(loudnessRange, 6.0f);
+    ASSERT_GE(loudnessRange, 4.0f);
+}
+
+TEST(EBU3342_Test_Set, Test_3)
+{
+    const std::string testFileName = "seq-3342-3-16bit-v02.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const float loudnessRange = measureLoudnessRange(*audioFile, createStereoConfig());
+    
+    ASSERT_LE(loudnessRange, 21.0f);
+    ASSERT_GE(loudnessRange, 19.0f);
+}
+
+TEST(EBU3342_Test_Set, Test_4)
+{
+    const std::string testFileName = "seq-3342-4-16bit-v02.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const float loudnessRange = measureLoudnessRange(*audioFile, createStereoConfig());
+    
+    ASSERT_LE(loudnessRange, 16.0f);
+    ASSERT_GE(loudnessRange, 14.0f);
+}
+
+TEST(EBU3342_Test_Set, Test_5)
+{
+    const std::string testFileName = "seq-3341-7_seq-3342-5-24bit.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const float loudnessRange = measureLoudnessRange(*audioFile, createStereoConfig());
+    
+    ASSERT_LE(loudnessRange, 6.0f);
+    ASSERT_GE(loudnessRange, 4.0f);
+}
+
+TEST(EBU3342_Test_Set, Test_6)
+{
+    const std::string testFileName = "seq-3341-2011-8_seq-3342-6-24bit-v02.wav";
+    
+    std::unique_ptr<drwav> audioFile = openTestFile(testFileName);
+    
+    if(!audioFile)
+    {
+        FAIL() << "Failed to open test file: " << testFileName;
+    }
+    
+    const float loudnessRange = measureLoudnessRange(*audioFile, createStereoConfig());
+    
+    ASSERT_LE(loudnessRange, 16.0f);
+    ASSERT_GE(loudnessRange, 14.0f);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <filesystem>
+#include <cassert>
+#include <optional>
+#include <memory>
+#include <functional>
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#include "dr_wav.h"
+
+#include "Channel.h"
+
+inline std::optional<std::filesystem::path> getTestContentPath()
+{
+    const std::filesystem::path path = std::filesystem::current_path() / "test_content";
+    std::cout << path << std::endl;
+
+    return std::filesystem::exists(path) ? path : std::optional<std::filesystem::path>(std::nullopt);
+}
+
+inline std::unique_ptr<drwav> openTestFile(std::string_view testFileName)
+{
+    const std::optional<std::filesystem::path> contentPath = getTestContentPath();
+    
+    if(!contentPath)
+    {
+        return nullptr;
+    }
+    
+    const std::filesystem::path filePath = *contentPath / testFileName;
+    const auto filePathString = filePath.string();
+
+    std::unique_ptr<drwav> audioFile = std::make_unique<drwav>();
+    
+    if(!drwav_init_file(audioFile.get(), filePathString.c_str(), nullptr))
+    {
+        return nullptr;
+    }
+    
+    return audioFile;
+}
+
+inline std::vector<LUFS::Channel> createStereoConfig()
+{
+    return {
+        LUFS::Channel::createStandard(LUFS::StandardChannel::Left), 
+        LUFS::Channel::createStandard(LUFS::StandardChannel::Right)
+    };
+}
+
+inline std::vector<LUFS::Channel> create5point0Config()
+{
+    return {
+        LUFS::Channel::createStandard(LUFS::StandardChannel::Left), 
+        LUFS::Channel::createStandard(LUFS::StandardChannel::Right),
+        LUFS::Channel::createStandard(LUFS::StandardChannel::Centre), 
+        LUFS::Channel::createStandard(LUFS::StandardChannel::LeftSurround),
+        LUFS::Channel::createStandard(LUFS::StandardChannel::RightSurround),
+    };
+}
+
+inline void processFile(drwav& file, std::function<void(const std::vector<std::vector<float>>&)> audioBufferCallback, int maxBufferSize)
+{
+    assert(audioBufferCallback);
+    
+    std::vector<float> interleavedBuffer(file.channels * maxBufferSize);
+    std::vector<std::vector<float>> deinterleavedBuffer(file.channels);
+    uint64_t numFramesRead = maxBufferSize;
+    
+    while(numFramesRead >= maxBufferSize)
+    {
+        numFramesRead = drwav_read_pcm_frames_f32(&file, maxBufferSize, interleavedBuffer.data());
+        
+        //Resize each channel and deinterleave samples
+        size_t channelIndex = 0;
+        std::for_each(deinterleavedBuffer.begin(), deinterleavedBuffer.end(), [&](std::vector<float>& channelBuffer)
+        {
+            channelBuffer.resize(numFramesRead);
+            
+            for(int sampleIndex = 0; sampleIndex < numFramesRead; ++sampleIndex)
+            {
+                channelBuffer[sampleIndex] = interleavedBuffer[sampleIndex * file.channels + channelIndex];
+            }
+            
+            ++channelIndex;
+        });
+        
+        audioBufferCallback(deinterleavedBuffer);
+    }
+}